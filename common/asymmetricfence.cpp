@@ -0,0 +1,58 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <cassert>
+#include "asymmetricfence.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(__NR_membarrier)
+#define CPP11OM_HAVE_MEMBARRIER 1
+// From <linux/membarrier.h>. Defined here because older headers lack the expedited commands,
+// and because they're declared as enumerators, which can't be tested with #ifdef.
+enum
+{
+    CPP11OM_MEMBARRIER_CMD_QUERY = 0,
+    CPP11OM_MEMBARRIER_CMD_PRIVATE_EXPEDITED = (1 << 3),
+    CPP11OM_MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED = (1 << 4),
+};
+#else
+#define CPP11OM_HAVE_MEMBARRIER 0
+#endif
+
+
+bool AsymmetricFence::s_isAsymmetric = AsymmetricFence::registerMembarrier();
+bool AsymmetricFence::s_membarrierAvailable = AsymmetricFence::s_isAsymmetric;     // Initialized after s_isAsymmetric, since it's defined later in this file.
+
+bool AsymmetricFence::registerMembarrier()
+{
+#if CPP11OM_HAVE_MEMBARRIER
+    // The kernel (or a seccomp filter) may not support the command we need.
+    long cmds = syscall(__NR_membarrier, CPP11OM_MEMBARRIER_CMD_QUERY, 0);
+    if (cmds < 0 || (cmds & CPP11OM_MEMBARRIER_CMD_PRIVATE_EXPEDITED) == 0)
+        return false;
+    // The process must register before it can use the private expedited command.
+    return syscall(__NR_membarrier, CPP11OM_MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+void AsymmetricFence::heavy()
+{
+#if CPP11OM_HAVE_MEMBARRIER
+    if (s_isAsymmetric)
+    {
+        long rc = syscall(__NR_membarrier, CPP11OM_MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+        assert(rc == 0);
+        (void) rc;
+        return;
+    }
+#endif
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
@@ -0,0 +1,58 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_ASYMMETRIC_FENCE_H__
+#define __CPP11OM_ASYMMETRIC_FENCE_H__
+
+#include <atomic>
+
+
+//---------------------------------------------------------
+// AsymmetricFence
+// A pair of fences for Dekker-style handshakes where one side runs far more often
+// than the other, such as a reader announcing itself and then checking for a writer.
+// Pairing light() on the frequent side with heavy() on the rare side gives the same
+// guarantee as a seq_cst fence on both sides.
+// On Linux 4.14+, heavy() calls membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED), which
+// forces a full memory barrier on every running thread of the process, so light() only
+// needs to stop the compiler from reordering. Elsewhere, both are seq_cst fences.
+// The decision is made during static initialization, so don't rely on these from
+// other static initializers.
+//---------------------------------------------------------
+class AsymmetricFence
+{
+private:
+    static bool s_isAsymmetric;
+    static bool s_membarrierAvailable;
+
+    static bool registerMembarrier();
+
+public:
+    static void light()
+    {
+        if (s_isAsymmetric)
+            std::atomic_signal_fence(std::memory_order_seq_cst);    // Compiler barrier
+        else
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    static void heavy();
+
+    static bool isAsymmetric()
+    {
+        return s_isAsymmetric;
+    }
+
+    // Makes light() and heavy() use seq_cst fences even when membarrier is available, or
+    // undoes that. Meant for benchmarks that compare the two. Only call while no other
+    // thread is using AsymmetricFence.
+    static void forceFallback(bool force)
+    {
+        s_isAsymmetric = s_membarrierAvailable && !force;
+    }
+};
+
+
+#endif // __CPP11OM_ASYMMETRIC_FENCE_H__
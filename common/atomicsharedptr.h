@@ -0,0 +1,158 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_ATOMIC_SHARED_PTR_H__
+#define __CPP11OM_ATOMIC_SHARED_PTR_H__
+
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+
+//---------------------------------------------------------
+// AtomicSharedPtr
+// A std::shared_ptr<T> that threads can load() and store() concurrently, without a lock.
+// Meant for data that's read often and replaced rarely, such as the current configuration:
+// readers get a consistent snapshot, which stays alive for as long as they hold it.
+//
+// Uses split reference counts. Each store() wraps the shared_ptr in a Node. m_head packs
+// the current Node's address with an "external" count of readers that are in the middle
+// of load(). A reader increments the external count in the same CAS that reads the
+// address, so the Node can't be freed under it, copies the shared_ptr, then decrements the
+// external count again. If a store() replaced the Node meanwhile, the storer moved the
+// external count into the Node's "internal" count, and the reader decrements that instead.
+// Whoever brings the internal count to zero deletes the Node.
+//
+// A Node can't be freed while a reader still counts on it, so its address can't be reused
+// either, which rules out ABA on m_head.
+// The address must fit in POINTER_BITS. On 64-bit platforms, user-space addresses fit in
+// 48 bits unless you ask mmap() for more; the assert in pack() will catch it.
+// At most 2^COUNT_BITS - 1 threads can be inside load() at once.
+//---------------------------------------------------------
+template <class T>
+class AtomicSharedPtr
+{
+private:
+    struct Node
+    {
+        std::atomic<int> internalCount;
+        std::shared_ptr<T> ptr;
+
+        Node(const std::shared_ptr<T>& p) : internalCount(0), ptr(p) {}
+    };
+
+    static const int POINTER_BITS = sizeof(void*) == 8 ? 48 : 32;
+    static const int COUNT_BITS = 64 - POINTER_BITS;
+    static const uint64_t POINTER_MASK = (uint64_t(1) << POINTER_BITS) - 1;
+    static const uint64_t COUNT_ONE = uint64_t(1) << POINTER_BITS;
+
+    std::atomic<uint64_t> m_head;
+
+    AtomicSharedPtr(const AtomicSharedPtr& other) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr& other) = delete;
+
+    static uint64_t pack(Node* node)
+    {
+        uint64_t bits = (uint64_t) (uintptr_t) node;
+        assert((bits & ~POINTER_MASK) == 0);
+        return bits;
+    }
+
+    static Node* nodeOf(uint64_t head)
+    {
+        return (Node*) (uintptr_t) (head & POINTER_MASK);
+    }
+
+    static uint64_t externalCountOf(uint64_t head)
+    {
+        return head >> POINTER_BITS;
+    }
+
+    static Node* makeNode(const std::shared_ptr<T>& ptr)
+    {
+        return ptr ? new Node(ptr) : nullptr;
+    }
+
+    // Called by the thread that unlinked node from m_head, with the external count it had.
+    static void retire(Node* node, uint64_t externalCount)
+    {
+        if (!node)
+            return;
+        // Readers that found node already unlinked may have driven the internal count negative.
+        // Pairs with the release in their fetch_sub, so that their copies happen before the delete.
+        int added = (int) externalCount;
+        if (node->internalCount.fetch_add(added, std::memory_order_acq_rel) + added == 0)
+            delete node;
+    }
+
+public:
+    AtomicSharedPtr() : m_head(0) {}
+
+    AtomicSharedPtr(const std::shared_ptr<T>& ptr) : m_head(pack(makeNode(ptr))) {}
+
+    ~AtomicSharedPtr()
+    {
+        // No other thread may be using this object anymore.
+        delete nodeOf(m_head.load(std::memory_order_relaxed));
+    }
+
+    std::shared_ptr<T> load()
+    {
+        // Take an external reference, so that the Node stays alive while we copy from it.
+        uint64_t oldHead = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (!nodeOf(oldHead))
+                return std::shared_ptr<T>();
+            assert(externalCountOf(oldHead) + 1 < (uint64_t(1) << COUNT_BITS));
+            // Acquire pairs with the release in store(), so that we see the Node's contents.
+            if (m_head.compare_exchange_weak(oldHead, oldHead + COUNT_ONE, std::memory_order_acquire, std::memory_order_relaxed))
+                break;
+        }
+        Node* node = nodeOf(oldHead);
+        std::shared_ptr<T> result = node->ptr;
+
+        // Give the reference back. If the Node is still current, undo our increment in m_head.
+        // Release pairs with the exchange in store(), so that our copy happens before the delete.
+        uint64_t head = oldHead + COUNT_ONE;
+        while (nodeOf(head) == node)
+        {
+            assert(externalCountOf(head) > 0);
+            if (m_head.compare_exchange_weak(head, head - COUNT_ONE, std::memory_order_release, std::memory_order_relaxed))
+                return result;
+        }
+        // A store() unlinked it, and moved our reference into the internal count.
+        // Release orders our copy before the delete, wherever it happens.
+        if (node->internalCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete node;
+        return result;
+    }
+
+    std::shared_ptr<T> exchange(const std::shared_ptr<T>& ptr)
+    {
+        Node* newNode = makeNode(ptr);
+        // Release publishes the new Node's contents to load().
+        uint64_t oldHead = m_head.exchange(pack(newNode), std::memory_order_acq_rel);
+        Node* oldNode = nodeOf(oldHead);
+        std::shared_ptr<T> result;
+        if (oldNode)
+        {
+            // oldNode can't be deleted before retire(), but readers may still be copying
+            // from its shared_ptr. Copy it rather than moving it out.
+            result = oldNode->ptr;
+            retire(oldNode, externalCountOf(oldHead));
+        }
+        return result;
+    }
+
+    void store(const std::shared_ptr<T>& ptr)
+    {
+        exchange(ptr);
+    }
+};
+
+
+#endif // __CPP11OM_ATOMIC_SHARED_PTR_H__
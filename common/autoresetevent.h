@@ -12,19 +12,41 @@
 
 
 //---------------------------------------------------------
-// AutoResetEvent
+// BasicAutoResetEvent
+// SemaphoreType is what waiting threads sleep on. Use the AutoResetEvent alias, unless
+// you need a pollable event; see PollableAutoResetEvent (below).
+// StatsPolicy and AlignmentPolicy are described in policies.h.
 //---------------------------------------------------------
-class AutoResetEvent
+template <class SemaphoreType, class StatsPolicy = NoStats, class AlignmentPolicy = NoAlignment>
+class BasicAutoResetEvent : private StatsPolicy, private AlignmentPolicy
 {
 private:
     // m_status == 1: Event object is signaled.
     // m_status == 0: Event object is reset and no threads are waiting.
     // m_status == -N: Event object is reset and N threads are waiting.
     std::atomic<int> m_status;
-    DefaultSemaphoreType m_sema;
+    SemaphoreType m_sema;
+
+    // Called by a waiter that gave up. Stop counting ourselves as a waiter, unless a concurrent
+    // signal() already released every waiter, including us. In that case, it owes us a
+    // semaphore signal, so take it and return true.
+    bool cancelWait()
+    {
+        int oldStatus = m_status.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (oldStatus >= 0)
+            {
+                m_sema.wait();
+                return true;
+            }
+            if (m_status.compare_exchange_weak(oldStatus, oldStatus + 1, std::memory_order_relaxed))
+                return false;
+        }
+    }
 
 public:
-    AutoResetEvent(int initialStatus = 0) : m_status(initialStatus)
+    BasicAutoResetEvent(int initialStatus = 0) : m_status(initialStatus)
     {
         assert(initialStatus >= 0 && initialStatus <= 1);
     }
@@ -51,10 +73,69 @@ public:
         assert(oldStatus <= 1);
         if (oldStatus < 1)
         {
+            StatsPolicy::onKernelWait();
             m_sema.wait();
         }
+        else
+        {
+            StatsPolicy::onUncontended();
+        }
+    }
+
+    // Returns false if the timeout expired before the event was signaled.
+    bool timedWait(uint64_t usecs)
+    {
+        int oldStatus = m_status.fetch_sub(1, std::memory_order_acquire);
+        assert(oldStatus <= 1);
+        if (oldStatus == 1 || m_sema.timedWait(usecs))
+            return true;
+        return cancelWait();
+    }
+
+    // For waiting from an event loop. Same protocol as the pollable waits in
+    // BasicLightweightSemaphore; finishPollableWait() needs a non-blocking SemaphoreType::tryWait().
+    bool beginPollableWait()
+    {
+        int oldStatus = m_status.fetch_sub(1, std::memory_order_acquire);
+        assert(oldStatus <= 1);
+        return oldStatus == 1;
+    }
+
+    bool finishPollableWait()
+    {
+        return m_sema.tryWait();
+    }
+
+    bool cancelPollableWait()
+    {
+        return cancelWait();
+    }
+
+    int fd() const
+    {
+        return m_sema.fd();
+    }
+
+    SemaphoreType& kernelSemaphore()
+    {
+        return m_sema;
+    }
+
+    const StatsPolicy& stats() const
+    {
+        return *this;
     }
 };
 
 
+typedef BasicAutoResetEvent<DefaultSemaphoreType> AutoResetEvent;
+
+#if defined(__linux__)
+// Sleeps directly on an eventfd. Spinning in a LightweightSemaphore first wouldn't help
+// a thread that waits by polling.
+typedef BasicAutoResetEvent<EventfdSemaphore> PollableAutoResetEvent;
+typedef BasicAutoResetEvent<FutexSemaphore> FutexAutoResetEvent;
+#endif
+
+
 #endif // __CPP11OM_AUTO_RESET_EVENT_H__
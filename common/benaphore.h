@@ -13,23 +13,65 @@
 
 
 //---------------------------------------------------------
-// NonRecursiveBenaphore
+// BasicNonRecursiveBenaphore
+// SemaphoreType is what contending threads wait on; pick its spin policy there, unless
+// OwnerSpinPolicy spins in the lock itself.
+// Use the NonRecursiveBenaphore alias (below) for the defaults.
 //---------------------------------------------------------
-class NonRecursiveBenaphore
+template <class SemaphoreType = DefaultSemaphoreType, class StatsPolicy = NoStats, class AlignmentPolicy = NoAlignment,
+          class OwnerSpinPolicy = NoOwnerSpin>
+class BasicNonRecursiveBenaphore : private StatsPolicy, private AlignmentPolicy, private OwnerSpinPolicy
 {
 private:
     std::atomic<int> m_contentionCount;
-    DefaultSemaphoreType m_sema;
+    SemaphoreType m_sema;
+
+    // Returns true if we took the lock before giving up.
+    bool spinWhileOwnerRuns()
+    {
+        for (int i = 0; OwnerSpinPolicy::keepSpinning(i); i++)
+        {
+            int count = m_contentionCount.load(std::memory_order_relaxed);
+            if (count == 0)
+            {
+                if (m_contentionCount.compare_exchange_strong(count, 1, std::memory_order_acquire))
+                {
+                    if (i == 0)
+                        StatsPolicy::onUncontended();
+                    else
+                        StatsPolicy::onSpinSuccess();
+                    return true;
+                }
+            }
+            else if (count > 1)
+            {
+                return false;   // Threads are already queued, and unlock() will hand the lock to them.
+            }
+            std::atomic_signal_fence(std::memory_order_acquire);     // Prevent the compiler from collapsing the loop.
+        }
+        return false;
+    }
 
 public:
-    NonRecursiveBenaphore() : m_contentionCount(0) {}
+    BasicNonRecursiveBenaphore() : m_contentionCount(0) {}
 
     void lock()
     {
+        if (OwnerSpinPolicy::beginSpin() && spinWhileOwnerRuns())
+        {
+            OwnerSpinPolicy::onAcquired();
+            return;
+        }
         if (m_contentionCount.fetch_add(1, std::memory_order_acquire) > 0)
         {
+            StatsPolicy::onKernelWait();
             m_sema.wait();
         }
+        else
+        {
+            StatsPolicy::onUncontended();
+        }
+        OwnerSpinPolicy::onAcquired();
     }
 
     bool tryLock()
@@ -37,7 +79,10 @@ public:
         if (m_contentionCount.load(std::memory_order_relaxed) != 0)
             return false;
         int expected = 0;
-        return m_contentionCount.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+        if (!m_contentionCount.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+            return false;
+        OwnerSpinPolicy::onAcquired();
+        return true;
     }
 
     void unlock()
@@ -49,22 +94,58 @@ public:
             m_sema.signal();
         }
     }
+
+    const StatsPolicy& stats() const
+    {
+        return *this;
+    }
 };
 
+typedef BasicNonRecursiveBenaphore<> NonRecursiveBenaphore;
+
 
 //---------------------------------------------------------
-// RecursiveBenaphore
+// BasicRecursiveBenaphore
+// Same parameters as BasicNonRecursiveBenaphore. Use the RecursiveBenaphore alias (below).
 //---------------------------------------------------------
-class RecursiveBenaphore
+template <class SemaphoreType = DefaultSemaphoreType, class StatsPolicy = NoStats, class AlignmentPolicy = NoAlignment,
+          class OwnerSpinPolicy = NoOwnerSpin>
+class BasicRecursiveBenaphore : private StatsPolicy, private AlignmentPolicy, private OwnerSpinPolicy
 {
 private:
     std::atomic<int> m_contentionCount;
     std::atomic<std::thread::id> m_owner;
     int m_recursion;
-    DefaultSemaphoreType m_sema;
+    SemaphoreType m_sema;
+
+    // Same as in BasicNonRecursiveBenaphore. Only called when we aren't the owner already.
+    bool spinWhileOwnerRuns()
+    {
+        for (int i = 0; OwnerSpinPolicy::keepSpinning(i); i++)
+        {
+            int count = m_contentionCount.load(std::memory_order_relaxed);
+            if (count == 0)
+            {
+                if (m_contentionCount.compare_exchange_strong(count, 1, std::memory_order_acquire))
+                {
+                    if (i == 0)
+                        StatsPolicy::onUncontended();
+                    else
+                        StatsPolicy::onSpinSuccess();
+                    return true;
+                }
+            }
+            else if (count > 1)
+            {
+                return false;   // Threads are queued, or the owner has recursed. Either way, don't wait it out.
+            }
+            std::atomic_signal_fence(std::memory_order_acquire);     // Prevent the compiler from collapsing the loop.
+        }
+        return false;
+    }
 
 public:
-    RecursiveBenaphore()
+    BasicRecursiveBenaphore()
     : m_contentionCount(0)
 // Apple LLVM 6.0 (in Xcode 6.1) refuses to initialize m_owner from a std::thread::id.
 // "error: no viable conversion from 'std::__1::__thread_id' to '_Atomic(std::__1::__thread_id)'"
@@ -91,14 +172,31 @@ public:
     void lock()
     {
         std::thread::id tid = std::this_thread::get_id();
-        if (m_contentionCount.fetch_add(1, std::memory_order_acquire) > 0)
+        bool acquired = OwnerSpinPolicy::beginSpin() && tid != m_owner.load(std::memory_order_relaxed) && spinWhileOwnerRuns();
+        if (!acquired)
         {
-            if (tid != m_owner.load(std::memory_order_relaxed))
-                m_sema.wait();
+            if (m_contentionCount.fetch_add(1, std::memory_order_acquire) > 0)
+            {
+                if (tid != m_owner.load(std::memory_order_relaxed))
+                {
+                    StatsPolicy::onKernelWait();
+                    m_sema.wait();
+                }
+                else
+                {
+                    // Re-entered by the owner, which never waits.
+                    StatsPolicy::onUncontended();
+                }
+            }
+            else
+            {
+                StatsPolicy::onUncontended();
+            }
         }
         //--- We are now inside the lock ---
         m_owner.store(tid, std::memory_order_relaxed);
-        m_recursion++;
+        if (m_recursion++ == 0)
+            OwnerSpinPolicy::onAcquired();
     }
  
     bool tryLock()
@@ -118,6 +216,7 @@ public:
                 return false;
             //--- We are now inside the lock ---
             m_owner.store(tid, std::memory_order_relaxed);
+            OwnerSpinPolicy::onAcquired();
         }
         m_recursion++;
         return true;
@@ -136,7 +235,14 @@ public:
         }
         //--- We are now outside the lock ---
     }
+
+    const StatsPolicy& stats() const
+    {
+        return *this;
+    }
 };
 
+typedef BasicRecursiveBenaphore<> RecursiveBenaphore;
+
 
 #endif // __CPP11OM_BENAPHORE_H__
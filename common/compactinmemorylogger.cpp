@@ -0,0 +1,174 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <cassert>
+#include <cstring>
+#include "compactinmemorylogger.h"
+
+
+CPP11OM_THREAD_LOCAL CompactInMemoryLogger::ThreadCache CompactInMemoryLogger::s_threadCache;
+std::atomic<uint64_t> CompactInMemoryLogger::s_nextLoggerId(1);   // 0 means "no logger" in s_threadCache.
+
+CompactInMemoryLogger::ThreadLog::ThreadLog(std::thread::id tid, uint64_t timestamp)
+    : tid(tid)
+    , head(new Page(timestamp))
+    , tail(head.get())
+    , lastTimestamp(timestamp)
+    , lastParam(0)
+    , numEvents(0)
+{
+    std::memset(msgCache, 0, sizeof(msgCache));
+}
+
+CompactInMemoryLogger::CompactInMemoryLogger()
+    : m_loggerId(s_nextLoggerId.fetch_add(1, std::memory_order_relaxed))
+{
+    // Reserve ID 0 for nullptr. That way, the zero-filled entries of each ThreadLog::msgCache are valid.
+    m_messages.push_back(nullptr);
+    m_messageIds[nullptr] = 0;
+}
+
+CompactInMemoryLogger::ThreadLog* CompactInMemoryLogger::getThreadLogSlow()
+{
+    std::thread::id tid = std::this_thread::get_id();
+    ThreadLog* threadLog = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // This thread may have logged here before, then switched to another logger.
+        for (const std::unique_ptr<ThreadLog>& t : m_threadLogs)
+        {
+            if (t->tid == tid)
+            {
+                threadLog = t.get();
+                break;
+            }
+        }
+        if (!threadLog)
+        {
+            m_threadLogs.emplace_back(new ThreadLog(tid, now()));
+            threadLog = m_threadLogs.back().get();
+        }
+    }
+    s_threadCache.loggerId = m_loggerId;
+    s_threadCache.threadLog = threadLog;
+    return threadLog;
+}
+
+uint16_t CompactInMemoryLogger::internMessageSlow(ThreadLog* threadLog, const char* msg)
+{
+    uint16_t id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_messageIds.find(msg);
+        if (iter != m_messageIds.end())
+        {
+            id = iter->second;
+        }
+        else
+        {
+            assert(m_messages.size() <= 0xffff);    // Too many distinct messages for a 16-bit ID
+            id = uint16_t(m_messages.size());
+            m_messages.push_back(msg);
+            m_messageIds[msg] = id;
+        }
+    }
+    ThreadLog::CachedMsg& cached = threadLog->msgCache[(((uintptr_t) msg) >> 3) & (MSG_CACHE_SIZE - 1)];
+    cached.msg = msg;
+    cached.id = id;
+    return id;
+}
+
+CompactInMemoryLogger::Page* CompactInMemoryLogger::appendPage(ThreadLog* threadLog, uint64_t timestamp)
+{
+    // No lock needed: only the owning thread touches its own chain of pages.
+    Page* page = new Page(timestamp);
+    threadLog->tail->next = std::unique_ptr<Page>(page);
+    threadLog->tail = page;
+    threadLog->lastTimestamp = timestamp;
+    threadLog->lastParam = 0;
+    return page;
+}
+
+size_t CompactInMemoryLogger::eventCount() const
+{
+    size_t count = 0;
+    for (const std::unique_ptr<ThreadLog>& t : m_threadLogs)
+        count += t->numEvents;
+    return count;
+}
+
+size_t CompactInMemoryLogger::bytesUsed() const
+{
+    size_t bytes = 0;
+    for (const std::unique_ptr<ThreadLog>& t : m_threadLogs)
+    {
+        for (const Page* page = t->head.get(); page; page = page->next.get())
+            bytes += page->size;
+    }
+    return bytes;
+}
+
+CompactInMemoryLogger::Iterator::Iterator(const CompactInMemoryLogger* logger)
+    : m_logger(logger)
+    , m_current(-1)
+{
+    for (const std::unique_ptr<ThreadLog>& t : logger->m_threadLogs)
+    {
+        Cursor cursor;
+        cursor.threadLog = t.get();
+        cursor.page = t->head.get();
+        cursor.offset = 0;
+        cursor.msgId = 0;
+        cursor.timestamp = cursor.page->baseTimestamp;
+        cursor.param = 0;
+        if (decode(cursor))
+            m_cursors.push_back(cursor);
+    }
+    selectNext();
+}
+
+// Decodes the next event in the cursor's stream. Returns false when the stream is exhausted.
+bool CompactInMemoryLogger::Iterator::decode(Cursor& cursor)
+{
+    while (cursor.offset >= cursor.page->size)
+    {
+        const Page* next = cursor.page->next.get();
+        if (!next)
+            return false;
+        cursor.page = next;
+        cursor.offset = 0;
+        cursor.timestamp = next->baseTimestamp;
+        cursor.param = 0;
+    }
+    const uint8_t* start = cursor.page->data + cursor.offset;
+    const uint8_t* p = start;
+    uint64_t delta;
+    cursor.msgId = uint16_t(p[0] | (p[1] << 8));
+    p = readVarint(p + 2, delta);
+    cursor.timestamp += delta;
+    p = readVarint(p, delta);
+    cursor.param += unzigzag(delta);
+    cursor.offset += int(p - start);
+    return true;
+}
+
+void CompactInMemoryLogger::Iterator::selectNext()
+{
+    // Linear scan is fine: there's one cursor per logging thread.
+    m_current = -1;
+    for (int i = 0; i < (int) m_cursors.size(); i++)
+    {
+        if (m_current < 0 || m_cursors[i].timestamp < m_cursors[m_current].timestamp)
+            m_current = i;
+    }
+    if (m_current >= 0)
+    {
+        const Cursor& cursor = m_cursors[m_current];
+        m_event.tid = cursor.threadLog->tid;
+        m_event.msg = m_logger->m_messages[cursor.msgId];
+        m_event.param = size_t(cursor.param);
+        m_event.timestamp = cursor.timestamp;
+    }
+}
@@ -0,0 +1,242 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_COMPACT_IN_MEMORY_LOGGER_H__
+#define __CPP11OM_COMPACT_IN_MEMORY_LOGGER_H__
+
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include "threadlocal.h"
+
+
+//---------------------------------------------------------
+// CompactInMemoryLogger
+// Same purpose as InMemoryLogger, but spends roughly 4-6 bytes per event instead of 24:
+// - Each thread appends to its own chain of pages, so the thread ID is stored once per thread.
+// - Messages are interned to 16-bit IDs.
+// - Timestamps and params are stored as varint-encoded deltas from the thread's previous event.
+// Since no two threads share a page, log() never touches a shared cache line after the
+// thread's first event. The mutex is only locked the first time a thread logs and the first
+// time it logs a given message.
+// Each event is timestamped, and Iterator merges the per-thread streams back into a single
+// timeline. Events from different threads with identical timestamps are returned in an
+// unspecified order.
+// Iterator should only be used after logging is complete.
+//---------------------------------------------------------
+class CompactInMemoryLogger
+{
+public:
+    struct Event
+    {
+        std::thread::id tid;
+        const char* msg;
+        size_t param;
+        uint64_t timestamp;     // Nanoseconds on std::chrono::steady_clock.
+
+        Event() : msg(nullptr), param(0), timestamp(0) {}
+    };
+
+private:
+    static const int BYTES_PER_PAGE = 65536;
+    static const int MAX_EVENT_BYTES = 2 + 10 + 10;    // 16-bit message ID + two 64-bit varints
+    static const int MSG_CACHE_SIZE = 64;              // Must be a power of 2
+
+    struct Page
+    {
+        std::unique_ptr<Page> next;
+        int size;                   // Number of bytes of data used so far.
+        uint64_t baseTimestamp;     // Delta encoding restarts at the beginning of each page.
+        uint8_t data[BYTES_PER_PAGE];
+
+        Page(uint64_t timestamp) : size(0), baseTimestamp(timestamp) {}
+    };
+
+    // Only the owning thread ever writes to a ThreadLog.
+    struct ThreadLog
+    {
+        struct CachedMsg
+        {
+            const char* msg;
+            uint16_t id;
+        };
+
+        std::thread::id tid;
+        std::unique_ptr<Page> head;
+        Page* tail;
+        uint64_t lastTimestamp;
+        uint64_t lastParam;
+        size_t numEvents;
+        CachedMsg msgCache[MSG_CACHE_SIZE];     // Avoids locking m_mutex to intern known messages.
+
+        ThreadLog(std::thread::id tid, uint64_t timestamp);
+    };
+
+    // Remembers the last logger used by this thread. Logger IDs are never reused, so a
+    // stale entry can't be mistaken for a new logger allocated at the same address.
+    struct ThreadCache
+    {
+        uint64_t loggerId;
+        ThreadLog* threadLog;
+    };
+    static CPP11OM_THREAD_LOCAL ThreadCache s_threadCache;
+    static std::atomic<uint64_t> s_nextLoggerId;
+
+    uint64_t m_loggerId;
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadLog>> m_threadLogs;
+    std::vector<const char*> m_messages;                    // Indexed by message ID.
+    std::unordered_map<const char*, uint16_t> m_messageIds;
+
+    ThreadLog* getThreadLogSlow();
+    uint16_t internMessageSlow(ThreadLog* threadLog, const char* msg);
+    static Page* appendPage(ThreadLog* threadLog, uint64_t timestamp);
+
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint8_t* writeVarint(uint8_t* p, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            *p++ = uint8_t(value | 0x80);
+            value >>= 7;
+        }
+        *p++ = uint8_t(value);
+        return p;
+    }
+
+    static const uint8_t* readVarint(const uint8_t* p, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            uint8_t b = *p++;
+            value |= uint64_t(b & 0x7f) << shift;
+            if (b < 0x80)
+                return p;
+        }
+    }
+
+    // Zigzag encoding maps small negative deltas to small unsigned values.
+    static uint64_t zigzag(uint64_t delta)
+    {
+        return (delta << 1) ^ (uint64_t) ((int64_t) delta >> 63);
+    }
+
+    static uint64_t unzigzag(uint64_t value)
+    {
+        return (value >> 1) ^ (0 - (value & 1));
+    }
+
+public:
+    CompactInMemoryLogger();
+
+    void log(const char* msg, size_t param = 0)
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);    // Compiler barrier
+        ThreadLog* threadLog = s_threadCache.threadLog;
+        if (s_threadCache.loggerId != m_loggerId)
+            threadLog = getThreadLogSlow();
+
+        uint16_t msgId;
+        const ThreadLog::CachedMsg& cached = threadLog->msgCache[(((uintptr_t) msg) >> 3) & (MSG_CACHE_SIZE - 1)];
+        if (cached.msg == msg)
+            msgId = cached.id;
+        else
+            msgId = internMessageSlow(threadLog, msg);
+
+        uint64_t timestamp = now();
+        Page* page = threadLog->tail;
+        if (page->size > BYTES_PER_PAGE - MAX_EVENT_BYTES)
+            page = appendPage(threadLog, timestamp);
+        uint8_t* p = page->data + page->size;
+        p[0] = uint8_t(msgId);
+        p[1] = uint8_t(msgId >> 8);
+        p = writeVarint(p + 2, timestamp - threadLog->lastTimestamp);
+        p = writeVarint(p, zigzag(uint64_t(param) - threadLog->lastParam));
+        page->size = int(p - page->data);
+        threadLog->lastTimestamp = timestamp;
+        threadLog->lastParam = param;
+        threadLog->numEvents++;
+        std::atomic_signal_fence(std::memory_order_seq_cst);    // Compiler barrier
+    }
+
+    // Statistics. Like Iterator, these should only be used after logging is complete.
+    size_t eventCount() const;
+    size_t bytesUsed() const;
+
+    // Iterators are meant to be used only after all logging is complete.
+    // Decodes each thread's stream and returns the events merged by timestamp.
+    friend class Iterator;
+    class Iterator
+    {
+    private:
+        struct Cursor
+        {
+            const ThreadLog* threadLog;
+            const Page* page;
+            int offset;         // Offset of the next undecoded event.
+            uint16_t msgId;     // Most recently decoded event. Also serves as the base for the next delta.
+            uint64_t timestamp;
+            uint64_t param;
+        };
+
+        const CompactInMemoryLogger* m_logger;
+        std::vector<Cursor> m_cursors;
+        int m_current;      // Index of the cursor holding the current event, or -1 at the end.
+        Event m_event;
+
+        static bool decode(Cursor& cursor);
+        void selectNext();
+
+    public:
+        Iterator() : m_logger(nullptr), m_current(-1) {}
+        Iterator(const CompactInMemoryLogger* logger);
+
+        Iterator& operator++()
+        {
+            if (!decode(m_cursors[m_current]))
+                m_cursors.erase(m_cursors.begin() + m_current);
+            selectNext();
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            if (m_current < 0 || other.m_current < 0)
+                return m_current != other.m_current;
+            const Cursor& a = m_cursors[m_current];
+            const Cursor& b = other.m_cursors[other.m_current];
+            return (a.page != b.page) || (a.offset != b.offset);
+        }
+
+        const Event& operator*() const
+        {
+            return m_event;
+        }
+    };
+
+    Iterator begin() const
+    {
+        return Iterator(this);
+    }
+
+    Iterator end() const
+    {
+        return Iterator();
+    }
+};
+
+
+#endif // __CPP11OM_COMPACT_IN_MEMORY_LOGGER_H__
@@ -36,9 +36,13 @@ namespace DiningPhiloHelpers
 
 
 //---------------------------------------------------------
-// DiningPhilosophers
+// BasicDiningPhilosophers
+// SemaphoreType is what each waiting philosopher sleeps on. To keep the semaphores on separate
+// cache lines, give SemaphoreType CacheLineAlignment (see policies.h).
+// Use the DiningPhilosophers alias (below) for the default.
 //---------------------------------------------------------
-class DiningPhilosophers
+template <class SemaphoreType = DefaultSemaphoreType>
+class BasicDiningPhilosophers
 {
 private:
     int m_numPhilos;
@@ -52,8 +56,8 @@ private:
     std::vector<int> m_status;
 
     // "Bouncers"
-    // Can't use std::vector<DefaultSemaphoreType> because DefaultSemaphoreType is not copiable/movable.
-    std::unique_ptr<DefaultSemaphoreType[]> m_sema;
+    // Can't use std::vector<SemaphoreType> because SemaphoreType is not copiable/movable.
+    std::unique_ptr<SemaphoreType[]> m_sema;
 
     int left(int index) const { return DiningPhiloHelpers::left(index, m_numPhilos); }
     int right(int index) const { return DiningPhiloHelpers::right(index, m_numPhilos); }
@@ -93,10 +97,10 @@ private:
     }
 
 public:
-    DiningPhilosophers(int numPhilos) : m_numPhilos(numPhilos)
+    BasicDiningPhilosophers(int numPhilos) : m_numPhilos(numPhilos)
     {
         m_status.resize(numPhilos);
-        m_sema = std::unique_ptr<DefaultSemaphoreType[]>(new DefaultSemaphoreType[numPhilos]);
+        m_sema = std::unique_ptr<SemaphoreType[]>(new SemaphoreType[numPhilos]);
     }
 
     void beginEating(int philoIndex)
@@ -151,12 +155,16 @@ public:
     }
 };
 
+typedef BasicDiningPhilosophers<> DiningPhilosophers;
+
 
 //---------------------------------------------------------
-// LockReducedDiningPhilosophers
-// Version of DiningPhilosophers with a lock-free box office.
+// BasicLockReducedDiningPhilosophers
+// Version of BasicDiningPhilosophers with a lock-free box office.
+// Use the LockReducedDiningPhilosophers alias (below) for the default.
 //---------------------------------------------------------
-class LockReducedDiningPhilosophers
+template <class SemaphoreType = DefaultSemaphoreType>
+class BasicLockReducedDiningPhilosophers
 {
 private:
     int m_numPhilos;
@@ -173,8 +181,8 @@ private:
     std::atomic<IntType> m_allStatus;
 
     // "Bouncers"
-    // Can't use std::vector<DefaultSemaphoreType> because DefaultSemaphoreType is not copiable/movable.
-    std::unique_ptr<DefaultSemaphoreType[]> m_sema;
+    // Can't use std::vector<SemaphoreType> because SemaphoreType is not copiable/movable.
+    std::unique_ptr<SemaphoreType[]> m_sema;
 
     int left(int index) const { return DiningPhiloHelpers::left(index, m_numPhilos); }
     int right(int index) const { return DiningPhiloHelpers::right(index, m_numPhilos); }
@@ -214,13 +222,13 @@ private:
     }
 
 public:
-    LockReducedDiningPhilosophers(int numPhilos)
+    BasicLockReducedDiningPhilosophers(int numPhilos)
     : m_numPhilos(numPhilos)
     , m_allStatus(0)
     {
         assert(IntType(numPhilos) <= AllStatus().philos.maximum());
         assert(numPhilos < AllStatus().philos.numItems());
-        m_sema = std::unique_ptr<DefaultSemaphoreType[]>(new DefaultSemaphoreType[numPhilos]);
+        m_sema = std::unique_ptr<SemaphoreType[]>(new SemaphoreType[numPhilos]);
     }
 
     void beginEating(int philoIndex)
@@ -285,6 +293,8 @@ public:
     }
 };
 
+typedef BasicLockReducedDiningPhilosophers<> LockReducedDiningPhilosophers;
+
 
 typedef LockReducedDiningPhilosophers DefaultDiningPhilosophersType;
 
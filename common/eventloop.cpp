@@ -0,0 +1,193 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <cassert>
+#include <algorithm>
+#include <utility>
+#include "eventloop.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+//---------------------------------------------------------
+// EventLoop
+//---------------------------------------------------------
+EventLoop::~EventLoop()
+{
+    assert(!m_running);
+    // No other thread may post anymore, so whatever is still queued can be freed.
+    while (MPSCQueue::Node* node = m_queue.tryPop())
+        delete static_cast<TaskNode*>(node);
+    while (!m_timers.empty())
+    {
+        delete m_timers.top();
+        m_timers.pop();
+    }
+}
+
+EventLoop::TaskNode* EventLoop::allocNode(Task&& task)
+{
+    TaskNode* node = m_freeNodes.pop();
+    if (!node)
+        node = new TaskNode;
+    node->task = std::move(task);
+    return node;
+}
+
+void EventLoop::recycleNode(TaskNode* node)
+{
+    node->task = nullptr;   // Release whatever the task captured.
+    m_freeNodes.push(node);
+}
+
+void EventLoop::runNode(TaskNode* node)
+{
+    node->task();
+    recycleNode(node);
+}
+
+void EventLoop::dispatch(TaskNode* node)
+{
+    if (node->isDelayed && node->due > Clock::now())
+        m_timers.push(node);
+    else
+        runNode(node);
+}
+
+void EventLoop::runExpiredTimers()
+{
+    if (m_timers.empty())
+        return;
+    Clock::time_point now = Clock::now();
+    while (!m_timers.empty() && m_timers.top()->due <= now)
+    {
+        TaskNode* node = m_timers.top();
+        m_timers.pop();
+        runNode(node);
+    }
+}
+
+void EventLoop::post(Task task)
+{
+    TaskNode* node = allocNode(std::move(task));
+    node->isDelayed = false;
+    m_queue.push(node);
+}
+
+void EventLoop::postDelayed(uint64_t usecs, Task task)
+{
+    TaskNode* node = allocNode(std::move(task));
+    node->due = Clock::now() + std::chrono::microseconds(usecs);
+    node->isDelayed = true;
+    m_queue.push(node);
+}
+
+void EventLoop::run()
+{
+    m_running = true;
+    while (m_running)
+    {
+        runExpiredTimers();
+        MPSCQueue::Node* node;
+        if (m_timers.empty())
+        {
+            node = m_queue.pop();
+        }
+        else
+        {
+            // Round up, so that we don't wake just before the timer is due and spin.
+            Clock::duration wait = m_timers.top()->due - Clock::now();
+            int64_t usecs = std::chrono::duration_cast<std::chrono::microseconds>(wait).count() + 1;
+            node = m_queue.timedPop(usecs > 0 ? (uint64_t) usecs : 0);
+        }
+        if (node)
+            dispatch(static_cast<TaskNode*>(node));
+    }
+}
+
+void EventLoop::stop()
+{
+    post([this]{ m_running = false; });
+}
+
+
+//---------------------------------------------------------
+// EventLoopGroup
+//---------------------------------------------------------
+EventLoopGroup::EventLoopGroup(int numLoops, bool pinThreads)
+    : m_nextLoop(0)
+{
+    if (numLoops <= 0)
+        numLoops = std::max(1, (int) std::thread::hardware_concurrency());
+    for (int i = 0; i < numLoops; i++)
+        m_loops.emplace_back(new EventLoop);
+    for (int i = 0; i < numLoops; i++)
+        m_threads.emplace_back(&EventLoopGroup::threadFunc, this, i, pinThreads);
+}
+
+EventLoopGroup::~EventLoopGroup()
+{
+    for (std::unique_ptr<EventLoop>& loop : m_loops)
+        loop->stop();
+    for (std::thread& t : m_threads)
+        t.join();
+}
+
+void EventLoopGroup::threadFunc(int index, bool pinThreads)
+{
+    if (pinThreads)
+        pinCurrentThread(index);
+    m_loops[index]->run();
+}
+
+bool EventLoopGroup::pinCurrentThread(int index)
+{
+#if defined(_WIN32)
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) || processMask == 0)
+        return false;
+    int count = 0;
+    for (DWORD_PTR m = processMask; m; m &= m - 1)
+        count++;
+    int target = index % count;
+    for (int cpu = 0; cpu < (int) sizeof(DWORD_PTR) * 8; cpu++)
+    {
+        DWORD_PTR bit = (DWORD_PTR) 1 << cpu;
+        if ((processMask & bit) && target-- == 0)
+            return SetThreadAffinityMask(GetCurrentThread(), bit) != 0;
+    }
+    return false;
+#elif defined(__linux__)
+    // Respect the CPU set we were started with (taskset, cgroups) instead of assuming 0..N-1.
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return false;
+    int count = CPU_COUNT(&allowed);
+    if (count == 0)
+        return false;
+    int target = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed) && target-- == 0)
+        {
+            cpu_set_t single;
+            CPU_ZERO(&single);
+            CPU_SET(cpu, &single);
+            return pthread_setaffinity_np(pthread_self(), sizeof(single), &single) == 0;
+        }
+    }
+    return false;
+#else
+    // macOS only offers affinity tags, which are hints between threads, not cores.
+    (void) index;
+    return false;
+#endif
+}
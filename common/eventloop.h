@@ -0,0 +1,135 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_EVENT_LOOP_H__
+#define __CPP11OM_EVENT_LOOP_H__
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "mpscqueue.h"
+#include "lockfreestack.h"
+
+
+//---------------------------------------------------------
+// EventLoop
+// Single-threaded executor. Any thread can post tasks; the thread that calls run()
+// executes them in the order they were posted.
+// Tasks travel through a BlockingMPSCQueue, so posting is wait-free apart from the
+// allocation, and the loop thread only sleeps on an AutoResetEvent when it has nothing
+// to do. Producers only signal the event when the loop is actually parked.
+// Task nodes are recycled through a FreeList, so a steady stream of tasks doesn't hit the heap.
+// Delayed tasks wait in a min-heap that only the loop thread touches. While the heap is
+// non-empty, the loop parks with a timeout that expires when the earliest one is due.
+//---------------------------------------------------------
+class EventLoop
+{
+public:
+    typedef std::function<void()> Task;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct TaskNode : MPSCQueue::Node, LockFreeStack::Node
+    {
+        Task task;
+        Clock::time_point due;
+        bool isDelayed;
+    };
+
+    struct LaterDue
+    {
+        bool operator()(const TaskNode* a, const TaskNode* b) const
+        {
+            return a->due > b->due;
+        }
+    };
+
+    BlockingMPSCQueue m_queue;
+    FreeList<TaskNode> m_freeNodes;
+    std::priority_queue<TaskNode*, std::vector<TaskNode*>, LaterDue> m_timers;    // Loop thread only
+    bool m_running;                                                                 // Loop thread only
+
+    EventLoop(const EventLoop& other) = delete;
+    EventLoop& operator=(const EventLoop& other) = delete;
+
+    TaskNode* allocNode(Task&& task);
+    void recycleNode(TaskNode* node);
+    void runNode(TaskNode* node);
+    void dispatch(TaskNode* node);
+    void runExpiredTimers();
+
+public:
+    EventLoop() : m_running(false) {}
+    ~EventLoop();
+
+    // Can be called from any thread, including from a task running on this loop.
+    void post(Task task);
+
+    // Runs task on the loop thread no sooner than usecs from now.
+    void postDelayed(uint64_t usecs, Task task);
+
+    // Executes tasks on the calling thread until stop() takes effect.
+    void run();
+
+    // Makes run() return once every task posted before this call has run.
+    // Delayed tasks that are still pending are discarded when the EventLoop is destroyed.
+    void stop();
+};
+
+
+//---------------------------------------------------------
+// EventLoopGroup
+// Runs one EventLoop per thread. By default, there's one loop per hardware thread, and
+// each loop's thread is pinned to its own core, so that a loop keeps its caches warm
+// and the tasks it owns never migrate. Pinning is best-effort: it's skipped on
+// platforms that only support affinity hints, and silently fails in restricted sandboxes.
+// next() hands out loops round-robin.
+//---------------------------------------------------------
+class EventLoopGroup
+{
+private:
+    std::vector<std::unique_ptr<EventLoop>> m_loops;
+    std::vector<std::thread> m_threads;
+    std::atomic<unsigned int> m_nextLoop;
+
+    EventLoopGroup(const EventLoopGroup& other) = delete;
+    EventLoopGroup& operator=(const EventLoopGroup& other) = delete;
+
+    void threadFunc(int index, bool pinThreads);
+
+public:
+    // numLoops == 0 means one loop per hardware thread.
+    EventLoopGroup(int numLoops = 0, bool pinThreads = true);
+    // Stops every loop and joins its thread.
+    ~EventLoopGroup();
+
+    int size() const
+    {
+        return (int) m_loops.size();
+    }
+
+    EventLoop& loop(int index)
+    {
+        return *m_loops[index];
+    }
+
+    EventLoop& next()
+    {
+        return *m_loops[m_nextLoop.fetch_add(1, std::memory_order_relaxed) % m_loops.size()];
+    }
+
+    // Pins the calling thread to the index-th CPU it's allowed to run on, modulo the
+    // number of such CPUs. Returns false if the platform doesn't support it or the call failed.
+    static bool pinCurrentThread(int index);
+};
+
+
+#endif // __CPP11OM_EVENT_LOOP_H__
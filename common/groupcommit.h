@@ -0,0 +1,110 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_GROUP_COMMIT_H__
+#define __CPP11OM_GROUP_COMMIT_H__
+
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "sema.h"
+#include "benaphore.h"
+
+
+//---------------------------------------------------------
+// GroupCommit
+// Combines requests from many threads into batches, such as log appends that each need
+// an fsync, so that N threads pay for one flush instead of N.
+// submit() pushes the request onto a lock-free stack. The thread whose request lands on an
+// empty stack becomes the leader of the next batch. It waits on m_flushLock for the previous
+// batch to finish flushing, then takes every request that piled up meanwhile, passes them
+// to the flush function in submission order, and wakes their threads. The other threads are
+// followers, and sleep on a semaphore of their own until their batch has been flushed.
+// Every non-empty stack has exactly one leader, so no request is left behind.
+// The flush function runs under m_flushLock, so it never runs concurrently with itself.
+//---------------------------------------------------------
+template <class Request>
+class GroupCommit
+{
+public:
+    typedef std::function<void(const std::vector<Request*>& batch)> FlushFunc;
+
+private:
+    struct Waiter
+    {
+        Request* request;
+        Waiter* next;
+        DefaultSemaphoreType sema;
+    };
+
+    FlushFunc m_flush;
+    std::atomic<Waiter*> m_pending;
+    NonRecursiveBenaphore m_flushLock;
+    std::vector<Request*> m_batch;      // Protected by m_flushLock
+    std::vector<Waiter*> m_followers;   // Protected by m_flushLock
+    uint64_t m_batchCount;              // Protected by m_flushLock
+
+    GroupCommit(const GroupCommit& other) = delete;
+    GroupCommit& operator=(const GroupCommit& other) = delete;
+
+    void lead()
+    {
+        std::lock_guard<NonRecursiveBenaphore> lock(m_flushLock);
+        // Take everything submitted so far. The next submit() will elect a new leader.
+        // Acquire pairs with the release in submit(), so that we see the requests.
+        Waiter* waiter = m_pending.exchange(nullptr, std::memory_order_acquire);
+        assert(waiter);
+        m_batch.clear();
+        m_followers.clear();
+        for (; waiter; waiter = waiter->next)
+        {
+            m_batch.push_back(waiter->request);
+            m_followers.push_back(waiter);
+        }
+        // The stack is LIFO. Flush in submission order.
+        std::reverse(m_batch.begin(), m_batch.end());
+        m_flush(m_batch);
+        m_batchCount++;
+        // The last Waiter in the stack is our own, and nobody sleeps on it.
+        m_followers.pop_back();
+        for (Waiter* follower : m_followers)
+            follower->sema.signal();    // follower may be gone as soon as this returns.
+    }
+
+public:
+    GroupCommit(const FlushFunc& flush) : m_flush(flush), m_pending(nullptr), m_batchCount(0) {}
+
+    // Returns once request has been passed to the flush function, possibly by another thread.
+    void submit(Request& request)
+    {
+        Waiter waiter;
+        waiter.request = &request;
+        Waiter* head = m_pending.load(std::memory_order_relaxed);
+        do
+        {
+            waiter.next = head;
+            // CAS until successful. On failure, head will be updated with the latest value.
+        }
+        while (!m_pending.compare_exchange_weak(head, &waiter, std::memory_order_release, std::memory_order_relaxed));
+
+        if (head == nullptr)
+            lead();
+        else
+            waiter.sema.wait();     // The leader flushed our request; the semaphore synchronizes-with it.
+    }
+
+    // Number of batches flushed so far. Call when no submit() is in progress.
+    uint64_t batchCount() const
+    {
+        return m_batchCount;
+    }
+};
+
+
+#endif // __CPP11OM_GROUP_COMMIT_H__
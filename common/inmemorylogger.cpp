@@ -46,3 +46,33 @@ InMemoryLogger::Event* InMemoryLogger::allocateEventFromNewPage()
     // Return the reserved slot.
     return &page->events[0];
 }
+
+std::vector<const InMemoryLogger::Page*> InMemoryLogger::pageList() const
+{
+    std::vector<const Page*> pages;
+    for (const Page* page = m_head.get(); page; page = page->next.get())
+        pages.push_back(page);
+    return pages;
+}
+
+InMemoryLogger::EventColumns InMemoryLogger::exportColumns(int threadCount) const
+{
+    std::vector<const Page*> pages = pageList();
+    // Every page but the last is full, so each page's position in the columns is known up front.
+    size_t total = (pages.size() - 1) * EVENTS_PER_PAGE + pageSize(pages.back());
+    EventColumns columns;
+    columns.tids.resize(total);
+    columns.msgs.resize(total);
+    columns.params.resize(total);
+    parallelForEachPage(pages, [&](size_t i, const Event* events, int count)
+    {
+        size_t base = i * EVENTS_PER_PAGE;
+        for (int j = 0; j < count; j++)
+        {
+            columns.tids[base + j] = events[j].tid;
+            columns.msgs[base + j] = events[j].msg.load(std::memory_order_relaxed);
+            columns.params[base + j] = events[j].param;
+        }
+    }, threadCount);
+    return columns;
+}
@@ -10,6 +10,7 @@
 #include <mutex>
 #include <memory>
 #include <atomic>
+#include <vector>
 
 
 //---------------------------------------------------------
@@ -17,8 +18,12 @@
 // Logs an unbounded number of generic events.
 // Each event has a const char* message and a size_t param.
 // log() is usually lock-free, except when it's time allocate a new Page.
-// Iterator should only be used after logging is complete.
+// Iterator should only be used after logging is complete. To consume events while logging
+// is still in progress, use Reader instead. For Reader's sake, Event::msg is a
+// std::atomic<const char*>, which makes Event non-copyable: copy msg out with load() (or an
+// implicit conversion) rather than copying the whole Event.
 // Useful for post-mortem debugging and for validating tests, as DiningPhilosopherTester does.
+// For long logs, processPages() and exportColumns() spread the work over several threads.
 //---------------------------------------------------------
 class InMemoryLogger
 {
@@ -26,7 +31,7 @@ public:
     struct Event
     {
         std::thread::id tid;
-        const char* msg;
+        std::atomic<const char*> msg;   // Stored last, with release semantics, so that Reader knows the event is complete.
         size_t param;
 
         Event() : msg(nullptr), param(0) {}
@@ -52,7 +57,53 @@ private:
 
     Event* allocateEventFromNewPage();
 
+    static int pageSize(const Page* page)
+    {
+        int size = page->index.load(std::memory_order_relaxed);
+        return size < EVENTS_PER_PAGE ? size : EVENTS_PER_PAGE;
+    }
+
+    std::vector<const Page*> pageList() const;
+
+    // Calls func(pageIndex, events, count) for every page, on up to threadCount threads,
+    // including the caller. Threads take the next unprocessed page until none are left.
+    template <class Func>
+    void parallelForEachPage(const std::vector<const Page*>& pages, Func func, int threadCount) const
+    {
+        if (threadCount <= 0)
+            threadCount = (int) std::thread::hardware_concurrency();
+        if (threadCount > (int) pages.size())
+            threadCount = (int) pages.size();
+        std::atomic<size_t> nextPage(0);
+        auto worker = [&]()
+        {
+            for (;;)
+            {
+                size_t i = nextPage.fetch_add(1, std::memory_order_relaxed);
+                if (i >= pages.size())
+                    break;
+                func(i, pages[i]->events, pageSize(pages[i]));
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < threadCount; t++)
+            threads.emplace_back(worker);
+        worker();
+        // Joining makes every thread's results visible to the caller.
+        for (std::thread& t : threads)
+            t.join();
+    }
+
 public:
+    // Column-wise copy of the log, in log order. Handy for analyses that scan a single field,
+    // such as counting events per thread, since each column is contiguous.
+    struct EventColumns
+    {
+        std::vector<std::thread::id> tids;
+        std::vector<const char*> msgs;
+        std::vector<size_t> params;
+    };
+
     InMemoryLogger();
 
     void log(const char* msg, size_t param = 0)
@@ -74,12 +125,41 @@ public:
         else
             evt = allocateEventFromNewPage();   // Double-checked locking is performed inside here.
         evt->tid = std::this_thread::get_id();
-        evt->msg = msg;
         evt->param = param;
+        // Publishes the event to Reader. On x86, this compiles to a plain store. Weaker CPUs
+        // need an ordered store instead (stlr on ARM64), which can be slower.
+        evt->msg.store(msg, std::memory_order_release);
         std::atomic_signal_fence(std::memory_order_seq_cst);    // Compiler barrier
     }
 
-    // Iterators are meant to be used only after all logging is complete.
+    // Like Iterator, the following are meant to be used only after all logging is complete.
+
+    // Calls pageFunc(const Event* events, int count) on each page, in parallel on up to
+    // threadCount threads (0 means one per hardware thread). pageFunc may return any
+    // default-constructible type. Then folds the per-page results into init by calling
+    // merge(Total& total, const PageResult& pageResult) on the calling thread, in page order,
+    // which is also log order. So merge doesn't have to be commutative: an analysis whose
+    // outcome depends on earlier events can summarize each page on its own, and reconcile
+    // each summary with everything before it in merge.
+    template <class Total, class PageFunc, class MergeFunc>
+    Total processPages(Total init, PageFunc pageFunc, MergeFunc merge, int threadCount = 0) const
+    {
+        typedef decltype(pageFunc((const Event*) nullptr, 0)) PageResult;
+        std::vector<const Page*> pages = pageList();
+        // Not a std::vector, which packs bools into shared words that threads can't write concurrently.
+        std::unique_ptr<PageResult[]> pageResults(new PageResult[pages.size()]);
+        parallelForEachPage(pages, [&](size_t i, const Event* events, int count)
+        {
+            pageResults[i] = pageFunc(events, count);
+        }, threadCount);
+        for (size_t i = 0; i < pages.size(); i++)
+            merge(init, pageResults[i]);
+        return init;
+    }
+
+    // Copies every event into EventColumns, one page per task.
+    EventColumns exportColumns(int threadCount = 0) const;
+
     friend class Iterator;
     class Iterator
     {
@@ -130,6 +210,47 @@ public:
         Page* tail = m_tail.load(std::memory_order_relaxed);
         return Iterator(tail, tail->index);
     }
+
+    // Reads events in log order while other threads are still logging, such as from a thread
+    // that monitors a running test. Only one thread may use a given Reader. If the next
+    // event's slot has been reserved but not written yet, tryRead() waits for it by returning
+    // nullptr, even if later events are complete. Messages passed to log() must be non-null.
+    friend class Reader;
+    class Reader
+    {
+    private:
+        InMemoryLogger& m_logger;
+        const Page* m_page;
+        int m_index;
+
+    public:
+        Reader(InMemoryLogger& logger) : m_logger(logger), m_page(logger.m_head.get()), m_index(0) {}
+
+        // Returns the next event, or nullptr if it hasn't been logged yet.
+        const Event* tryRead()
+        {
+            if (m_index >= EVENTS_PER_PAGE)
+            {
+                // Page::next isn't atomic, but it's only written while holding m_mutex.
+                // This only happens once per page, so the lock is cheap.
+                const Page* next;
+                {
+                    std::lock_guard<std::mutex> lock(m_logger.m_mutex);
+                    next = m_page->next.get();
+                }
+                if (!next)
+                    return nullptr;
+                m_page = next;
+                m_index = 0;
+            }
+            const Event* evt = &m_page->events[m_index];
+            // Acquire pairs with the release in log(), so that we see tid and param.
+            if (!evt->msg.load(std::memory_order_acquire))
+                return nullptr;
+            m_index++;
+            return evt;
+        }
+    };
 };
 
 
@@ -0,0 +1,184 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_KEYED_LOCK_TABLE_H__
+#define __CPP11OM_KEYED_LOCK_TABLE_H__
+
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "benaphore.h"
+
+
+//---------------------------------------------------------
+// KeyedLockTable
+// Locks arbitrary 64-bit keys (row IDs, file IDs) without allocating a lock per key.
+// Each key hashes to one of a fixed number of lock stripes. Unrelated keys that share a
+// stripe contend needlessly, so a few known-hot keys can be given exact locks of their own
+// with addHotKey, before the table is shared.
+// LockType can be NonRecursiveBenaphore, NonRecursiveRWLock, or anything else with the
+// same interface. For a single key, use lockFor(key) with the usual guards:
+//
+//     ReadLockGuard<NonRecursiveRWLock> guard(table.lockFor(rowId));
+//
+// To lock several keys at once, use MultiKeyLockGuard and friends (below), which take
+// the locks in a canonical order to avoid deadlock.
+//---------------------------------------------------------
+template <class LockType = NonRecursiveBenaphore>
+class KeyedLockTable
+{
+private:
+    static const int CACHE_LINE_SIZE = 64;
+
+    // Keep each lock on its own cache line(s).
+    struct Stripe
+    {
+        LockType lock;
+        char padding[CACHE_LINE_SIZE - sizeof(LockType) % CACHE_LINE_SIZE];
+    };
+
+    struct HotKey
+    {
+        uint64_t key;
+        Stripe* stripe;
+    };
+
+    int m_numStripes;       // Power of 2
+    int m_maxHotKeys;
+    std::unique_ptr<char[]> m_buffer;
+    Stripe* m_stripes;      // m_numStripes followed by m_maxHotKeys, aligned to a cache line.
+    std::vector<HotKey> m_hotKeys;
+
+    KeyedLockTable(const KeyedLockTable& other) = delete;
+    KeyedLockTable& operator=(const KeyedLockTable& other) = delete;
+
+    static uint64_t hash(uint64_t key)
+    {
+        // MurmurHash3's 64-bit finalizer.
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33;
+        return key;
+    }
+
+public:
+    KeyedLockTable(int numStripes = 1024, int maxHotKeys = 0)
+    : m_numStripes(numStripes)
+    , m_maxHotKeys(maxHotKeys)
+    {
+        assert(numStripes > 0 && (numStripes & (numStripes - 1)) == 0);   // Must be a power of 2
+        assert(maxHotKeys >= 0);
+        int total = numStripes + maxHotKeys;
+        m_buffer = std::unique_ptr<char[]>(new char[total * sizeof(Stripe) + CACHE_LINE_SIZE - 1]);
+        uintptr_t aligned = ((uintptr_t) m_buffer.get() + CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CACHE_LINE_SIZE - 1);
+        m_stripes = (Stripe*) aligned;
+        for (int i = 0; i < total; i++)
+            new (&m_stripes[i]) Stripe;
+        m_hotKeys.reserve(maxHotKeys);
+    }
+
+    ~KeyedLockTable()
+    {
+        for (int i = 0; i < m_numStripes + m_maxHotKeys; i++)
+            m_stripes[i].~Stripe();
+    }
+
+    // Gives key an exact lock of its own. Not thread-safe: lockFor() reads the list of hot keys
+    // without synchronization, so register every hot key before any other thread uses the
+    // table at all, not just before key is locked.
+    // Lookups are a linear scan, so keep the number of hot keys small.
+    void addHotKey(uint64_t key)
+    {
+        assert((int) m_hotKeys.size() < m_maxHotKeys);
+        HotKey hotKey = { key, &m_stripes[m_numStripes + m_hotKeys.size()] };
+        m_hotKeys.push_back(hotKey);
+    }
+
+    LockType& lockFor(uint64_t key)
+    {
+        for (const HotKey& hotKey : m_hotKeys)
+        {
+            if (hotKey.key == key)
+                return hotKey.stripe->lock;
+        }
+        return m_stripes[hash(key) & (m_numStripes - 1)].lock;
+    }
+
+    // Stores the distinct locks for the given keys in canonical order, and returns how many
+    // there are. locks must have room for count entries.
+    // The order is by address, which is consistent across all threads and all tables.
+    size_t locksFor(const uint64_t* keys, size_t count, LockType** locks)
+    {
+        for (size_t i = 0; i < count; i++)
+            locks[i] = &lockFor(keys[i]);
+        std::sort(locks, locks + count, std::less<LockType*>());
+        return std::unique(locks, locks + count) - locks;
+    }
+};
+
+
+//---------------------------------------------------------
+// BasicMultiKeyLockGuard
+// Locks every distinct lock for a set of keys in canonical order, and unlocks them in
+// reverse order. As long as every thread that holds more than one lock from a table
+// takes them this way, no deadlock is possible.
+// Use the MultiKeyLockGuard, MultiKeyReadLockGuard and MultiKeyWriteLockGuard aliases.
+// Up to INLINE_KEYS keys are sorted in a buffer inside the guard. Only longer key lists
+// allocate from the heap.
+//---------------------------------------------------------
+template <class LockType, void (LockType::*Lock)(), void (LockType::*Unlock)()>
+class BasicMultiKeyLockGuard
+{
+public:
+    static const size_t INLINE_KEYS = 16;
+
+private:
+    LockType* m_inlineLocks[INLINE_KEYS];
+    std::unique_ptr<LockType*[]> m_heapLocks;
+    LockType** m_locks;
+    size_t m_count;
+
+    BasicMultiKeyLockGuard(const BasicMultiKeyLockGuard& other) = delete;
+    BasicMultiKeyLockGuard& operator=(const BasicMultiKeyLockGuard& other) = delete;
+
+public:
+    BasicMultiKeyLockGuard(KeyedLockTable<LockType>& table, const uint64_t* keys, size_t count)
+    {
+        m_locks = m_inlineLocks;
+        if (count > INLINE_KEYS)
+        {
+            m_heapLocks = std::unique_ptr<LockType*[]>(new LockType*[count]);
+            m_locks = m_heapLocks.get();
+        }
+        m_count = table.locksFor(keys, count, m_locks);
+        for (size_t i = 0; i < m_count; i++)
+            (m_locks[i]->*Lock)();
+    }
+
+    ~BasicMultiKeyLockGuard()
+    {
+        for (size_t i = m_count; i > 0; i--)
+            (m_locks[i - 1]->*Unlock)();
+    }
+};
+
+template <class LockType>
+using MultiKeyLockGuard = BasicMultiKeyLockGuard<LockType, &LockType::lock, &LockType::unlock>;
+
+template <class LockType>
+using MultiKeyReadLockGuard = BasicMultiKeyLockGuard<LockType, &LockType::lockReader, &LockType::unlockReader>;
+
+template <class LockType>
+using MultiKeyWriteLockGuard = BasicMultiKeyLockGuard<LockType, &LockType::lockWriter, &LockType::unlockWriter>;
+
+
+#endif // __CPP11OM_KEYED_LOCK_TABLE_H__
@@ -0,0 +1,10 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "leftright.h"
+
+
+CPP11OM_THREAD_LOCAL int LeftRightReadIndicator::s_stripePlusOne;
+std::atomic<int> LeftRightReadIndicator::s_nextThreadIndex(0);
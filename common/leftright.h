@@ -0,0 +1,170 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_LEFT_RIGHT_H__
+#define __CPP11OM_LEFT_RIGHT_H__
+
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <utility>
+#include "benaphore.h"
+#include "asymmetricfence.h"
+#include "threadlocal.h"
+
+
+//---------------------------------------------------------
+// LeftRightReadIndicator
+// Counts the readers inside a LeftRight. Spread over STRIPES cache lines, chosen by a
+// process-wide thread index, so that readers on different threads rarely share a line.
+//---------------------------------------------------------
+class LeftRightReadIndicator
+{
+private:
+    static const int STRIPES = 16;
+    static const int CACHE_LINE_SIZE = 64;
+
+    struct Stripe
+    {
+        std::atomic<int> count;
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<int>)];
+
+        Stripe() : count(0) {}
+    };
+
+    static CPP11OM_THREAD_LOCAL int s_stripePlusOne;
+    static std::atomic<int> s_nextThreadIndex;
+
+    Stripe m_stripes[STRIPES];
+
+    static int stripeIndex()
+    {
+        int plusOne = s_stripePlusOne;
+        if (plusOne == 0)
+        {
+            plusOne = s_nextThreadIndex.fetch_add(1, std::memory_order_relaxed) % STRIPES + 1;
+            s_stripePlusOne = plusOne;
+        }
+        return plusOne - 1;
+    }
+
+public:
+    // Returns the stripe to pass to depart().
+    int arrive()
+    {
+        int stripe = stripeIndex();
+        m_stripes[stripe].count.fetch_add(1, std::memory_order_relaxed);
+        return stripe;
+    }
+
+    void depart(int stripe)
+    {
+        // Orders the reader's accesses to the instance before the writer's next mutation of it.
+        int oldCount = m_stripes[stripe].count.fetch_sub(1, std::memory_order_release);
+        assert(oldCount > 0);
+        (void) oldCount;
+    }
+
+    // Called by the writer. Pairs with the release in depart().
+    void waitUntilEmpty()
+    {
+        for (int i = 0; i < STRIPES; i++)
+        {
+            int spin = 0;
+            while (m_stripes[i].count.load(std::memory_order_acquire) != 0)
+            {
+                if (++spin < 1000)
+                    std::atomic_signal_fence(std::memory_order_acquire);    // Prevent the compiler from collapsing the loop.
+                else
+                    std::this_thread::yield();
+            }
+        }
+    }
+};
+
+
+//---------------------------------------------------------
+// LeftRight
+// Keeps two copies of a T, so that readers never wait, even for writers: readers use one copy
+// while a writer modifies the other. A writer applies its mutation to the copy that readers
+// aren't using, points new readers at it, waits for the readers still on the old copy to leave,
+// then applies the same mutation to the old copy. Writers are serialized by a benaphore.
+// T can be any single-threaded container, such as std::unordered_map.
+// Reads are wait-free: an increment, AsymmetricFence::light(), a load, and a decrement.
+// Costs: twice the memory, each mutation runs twice, and a write waits for the readers
+// in front of it, so keep read functions short.
+// Based on "Left-Right: A Concurrency Control Technique with Wait-Free Population Oblivious
+// Reads" by Pedro Ramalhete and Andreia Correia.
+//---------------------------------------------------------
+template <class T>
+class LeftRight
+{
+private:
+    T m_instances[2];
+    std::atomic<int> m_leftRight;       // Which instance readers use
+    std::atomic<int> m_versionIndex;    // Which read indicator new readers arrive on
+    LeftRightReadIndicator m_readIndicators[2];
+    NonRecursiveBenaphore m_writerLock;
+
+    LeftRight(const LeftRight& other) = delete;
+    LeftRight& operator=(const LeftRight& other) = delete;
+
+    class ReadGuard
+    {
+    private:
+        LeftRightReadIndicator& m_indicator;
+        int m_stripe;
+
+    public:
+        ReadGuard(LeftRightReadIndicator& indicator) : m_indicator(indicator), m_stripe(indicator.arrive()) {}
+        ~ReadGuard() { m_indicator.depart(m_stripe); }
+    };
+
+public:
+    LeftRight() : m_leftRight(0), m_versionIndex(0) {}
+
+    LeftRight(const T& initial) : m_leftRight(0), m_versionIndex(0)
+    {
+        m_instances[0] = initial;
+        m_instances[1] = initial;
+    }
+
+    // Calls readFunc(const T&) and returns what it returns.
+    template <class ReadFunc>
+    auto read(const ReadFunc& readFunc) -> decltype(readFunc(std::declval<const T&>()))
+    {
+        int vi = m_versionIndex.load(std::memory_order_relaxed);
+        ReadGuard guard(m_readIndicators[vi]);
+        // Either we see the writer's new m_leftRight, or it sees our arrival. Pairs with heavy() in write().
+        AsymmetricFence::light();
+        // Acquire pairs with the release in write(), so that we see the writer's mutation.
+        const T& instance = m_instances[m_leftRight.load(std::memory_order_acquire)];
+        return readFunc(instance);
+    }
+
+    // Calls writeFunc(T&) on each copy in turn. It must make the same change both times.
+    template <class WriteFunc>
+    void write(const WriteFunc& writeFunc)
+    {
+        std::lock_guard<NonRecursiveBenaphore> lock(m_writerLock);
+        int lr = m_leftRight.load(std::memory_order_relaxed);
+        writeFunc(m_instances[1 - lr]);
+        m_leftRight.store(1 - lr, std::memory_order_release);
+        AsymmetricFence::heavy();
+        // Every reader that might still be using m_instances[lr] is counted in one of the read
+        // indicators. New readers may arrive, but they'll use the other copy. Wait for both
+        // indicators to drain, switching new readers to the empty one in between so that a
+        // steady stream of them can't keep the other one occupied forever.
+        int vi = m_versionIndex.load(std::memory_order_relaxed);
+        m_readIndicators[1 - vi].waitUntilEmpty();
+        m_versionIndex.store(1 - vi, std::memory_order_relaxed);
+        m_readIndicators[vi].waitUntilEmpty();
+        writeFunc(m_instances[lr]);
+    }
+};
+
+
+#endif // __CPP11OM_LEFT_RIGHT_H__
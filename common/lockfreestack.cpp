@@ -0,0 +1,9 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "lockfreestack.h"
+
+
+CPP11OM_THREAD_LOCAL uint32_t LockFreeStack::s_random;
@@ -0,0 +1,198 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_LOCK_FREE_STACK_H__
+#define __CPP11OM_LOCK_FREE_STACK_H__
+
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include "bitfield.h"
+#include "threadlocal.h"
+
+
+//---------------------------------------------------------
+// LockFreeStack
+// Intrusive Treiber stack. Nodes must derive from LockFreeStack::Node.
+// The head packs a pointer and a tag into 64 bits, and every successful update bumps
+// the tag, so a pop that was delayed while the head was popped and pushed back again
+// (the ABA problem) fails its CAS instead of corrupting the stack. This assumes user-space
+// pointers fit in 48 bits on 64-bit platforms, which holds on x86-64 and ARMv8 Linux,
+// macOS and Windows, but not with hardware pointer tagging in the top byte.
+// pop() may read the next field of a node that another thread has just popped, so
+// nodes must not be freed while any thread might still pop from the stack.
+// FreeList (below) satisfies that by construction.
+// When a CAS on the head fails, push() and pop() try to cancel each other out in an
+// elimination array before retrying, which takes pressure off the head under high contention.
+//---------------------------------------------------------
+class LockFreeStack
+{
+public:
+    struct Node
+    {
+        std::atomic<Node*> next;
+
+        Node() : next(nullptr) {}
+    };
+
+private:
+    static const int POINTER_BITS = sizeof(void*) == 8 ? 48 : 32;
+    static const int ELIMINATION_SLOTS = 8;                         // Must be a power of 2
+    static const int ELIMINATION_SPIN = 100;
+    static const int CACHE_LINE_SIZE = 64;
+
+    BEGIN_BITFIELD_TYPE(Head, uint64_t)
+        ADD_BITFIELD_MEMBER(ptr, 0, POINTER_BITS)
+        ADD_BITFIELD_MEMBER(tag, POINTER_BITS, 64 - POINTER_BITS)
+    END_BITFIELD_TYPE()
+
+    struct EliminationSlot
+    {
+        std::atomic<Node*> node;
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<Node*>)];
+
+        EliminationSlot() : node(nullptr) {}
+    };
+
+    std::atomic<uint64_t> m_head;
+    char m_padding[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+    EliminationSlot m_elimination[ELIMINATION_SLOTS];
+
+    static CPP11OM_THREAD_LOCAL uint32_t s_random;
+
+    LockFreeStack(const LockFreeStack& other) = delete;
+    LockFreeStack& operator=(const LockFreeStack& other) = delete;
+
+    static Node* toNode(const Head& head)
+    {
+        return (Node*) (uintptr_t) (uint64_t) head.ptr;
+    }
+
+    static Head makeHead(Node* node, const Head& prev)
+    {
+        assert(((uint64_t) (uintptr_t) node >> POINTER_BITS) == 0);    // Pointer doesn't fit
+        Head head;
+        head.ptr = (uint64_t) (uintptr_t) node;
+        head.tag = (prev.tag + 1) & prev.tag.maximum();
+        return head;
+    }
+
+    static EliminationSlot& pickSlot(EliminationSlot* slots)
+    {
+        // xorshift32. Seeded from the address of the thread-local, which differs per thread.
+        uint32_t x = s_random;
+        if (x == 0)
+            x = (uint32_t) (uintptr_t) &s_random | 1;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        s_random = x;
+        return slots[x & (ELIMINATION_SLOTS - 1)];
+    }
+
+    // Offers node to a concurrent pop(). Returns true if one took it.
+    bool tryEliminatePush(Node* node)
+    {
+        EliminationSlot& slot = pickSlot(m_elimination);
+        Node* expected = nullptr;
+        if (!slot.node.compare_exchange_strong(expected, node, std::memory_order_release, std::memory_order_relaxed))
+            return false;
+        for (int spin = 0; spin < ELIMINATION_SPIN; spin++)
+        {
+            if (slot.node.load(std::memory_order_relaxed) != node)
+                return true;
+            std::atomic_signal_fence(std::memory_order_seq_cst);    // Prevent the compiler from collapsing the loop.
+        }
+        // Withdraw the offer. If that fails, a pop() took the node in the meantime.
+        expected = node;
+        return !slot.node.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed, std::memory_order_relaxed);
+    }
+
+    // Takes a node offered by a concurrent push(), if any.
+    Node* tryEliminatePop()
+    {
+        EliminationSlot& slot = pickSlot(m_elimination);
+        Node* node = slot.node.load(std::memory_order_relaxed);
+        if (node && slot.node.compare_exchange_strong(node, nullptr, std::memory_order_acquire, std::memory_order_relaxed))
+            return node;
+        return nullptr;
+    }
+
+public:
+    LockFreeStack() : m_head(0) {}
+
+    void push(Node* node)
+    {
+        Head oldHead = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            node->next.store(toNode(oldHead), std::memory_order_relaxed);
+            Head newHead = makeHead(node, oldHead);
+            if (m_head.compare_exchange_weak(oldHead, newHead, std::memory_order_release, std::memory_order_relaxed))
+                return;
+            // Contention. Try to hand the node directly to a concurrent pop().
+            if (tryEliminatePush(node))
+                return;
+            oldHead = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    Node* pop()
+    {
+        Head oldHead = m_head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            Node* node = toNode(oldHead);
+            if (!node)
+                return nullptr;
+            // node may have been popped by another thread by now. If so, next is stale,
+            // but the tag guarantees the CAS below will fail.
+            Head newHead = makeHead(node->next.load(std::memory_order_relaxed), oldHead);
+            if (m_head.compare_exchange_weak(oldHead, newHead, std::memory_order_acquire, std::memory_order_acquire))
+                return node;
+            // Contention. Try to take a node directly from a concurrent push().
+            node = tryEliminatePop();
+            if (node)
+                return node;
+            oldHead = m_head.load(std::memory_order_acquire);
+        }
+    }
+};
+
+
+//---------------------------------------------------------
+// FreeList
+// Recycles objects of type T, which must derive from LockFreeStack::Node.
+// Objects pushed here must have been allocated with new. The FreeList deletes whatever
+// it still holds when it's destroyed. To keep LockFreeStack::pop() safe, don't delete
+// an object you popped while other threads might still pop from the list; push it back.
+//---------------------------------------------------------
+template <class T>
+class FreeList
+{
+private:
+    LockFreeStack m_stack;
+
+public:
+    ~FreeList()
+    {
+        while (T* obj = pop())
+            delete obj;
+    }
+
+    void push(T* obj)
+    {
+        m_stack.push(obj);
+    }
+
+    // Returns nullptr if the list is empty. It's up to the caller to allocate a new object.
+    T* pop()
+    {
+        return static_cast<T*>(m_stack.pop());
+    }
+};
+
+
+#endif // __CPP11OM_LOCK_FREE_STACK_H__
@@ -0,0 +1,175 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_MPSC_QUEUE_H__
+#define __CPP11OM_MPSC_QUEUE_H__
+
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "autoresetevent.h"
+
+
+//---------------------------------------------------------
+// MPSCQueue
+// Dmitry Vyukov's intrusive, unbounded, multiple-producer single-consumer queue.
+// Nodes must derive from MPSCQueue::Node. push() is wait-free: one exchange and one store.
+// tryPop() is lock-free, but it can return nullptr while a push() is half done,
+// even if older items are queued behind it. BlockingMPSCQueue (below) copes with that.
+// Only one thread may call tryPop() at a time.
+//---------------------------------------------------------
+class MPSCQueue
+{
+public:
+    struct Node
+    {
+        std::atomic<Node*> next;
+
+        Node() : next(nullptr) {}
+    };
+
+private:
+    std::atomic<Node*> m_head;  // Most recently pushed node. Producers exchange it.
+    Node* m_tail;               // Oldest node. Only the consumer touches it.
+    Node m_stub;                // Keeps the list non-empty so producers never touch m_tail.
+
+    MPSCQueue(const MPSCQueue& other) = delete;
+    MPSCQueue& operator=(const MPSCQueue& other) = delete;
+
+public:
+    MPSCQueue() : m_head(&m_stub), m_tail(&m_stub) {}
+
+    void push(Node* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        // Between these two lines, the consumer can't see node or anything pushed after it.
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    Node* tryPop()
+    {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub)
+        {
+            if (!next)
+                return nullptr;     // Empty
+            // Skip over the stub.
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            m_tail = next;
+            return tail;
+        }
+        // tail is the last linked node. If it isn't also the head, a push() is in progress.
+        if (tail != m_head.load(std::memory_order_acquire))
+            return nullptr;
+        // Put the stub back behind tail, so that tail can be unlinked.
+        push(&m_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next)
+        {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;     // Another push() slipped in before the stub, and is still in progress.
+    }
+};
+
+
+//---------------------------------------------------------
+// BlockingMPSCQueue
+// MPSCQueue whose consumer can sleep on an AutoResetEvent when the queue is empty.
+// Producers only signal the event when the consumer has announced that it's parking,
+// so in the common case, push() never touches a cache line owned by the consumer.
+//---------------------------------------------------------
+class BlockingMPSCQueue
+{
+private:
+    MPSCQueue m_queue;
+    std::atomic<int> m_consumerWaiting;
+    AutoResetEvent m_event;
+
+public:
+    typedef MPSCQueue::Node Node;
+
+    BlockingMPSCQueue() : m_consumerWaiting(0) {}
+
+    void push(Node* node)
+    {
+        m_queue.push(node);
+        // Either we see m_consumerWaiting, or the consumer sees node. Pairs with the fence in pop().
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumerWaiting.load(std::memory_order_relaxed) != 0
+            && m_consumerWaiting.exchange(0, std::memory_order_relaxed) != 0)
+        {
+            m_event.signal();
+        }
+    }
+
+    Node* tryPop()
+    {
+        return m_queue.tryPop();
+    }
+
+    // Blocks until a node is available.
+    Node* pop()
+    {
+        for (;;)
+        {
+            Node* node = m_queue.tryPop();
+            if (node)
+                return node;
+            m_consumerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            node = m_queue.tryPop();
+            if (node)
+            {
+                // A producer may have signaled anyway. That just makes a later wait() return early.
+                m_consumerWaiting.store(0, std::memory_order_relaxed);
+                return node;
+            }
+            m_event.wait();
+        }
+    }
+
+    // Like pop(), but gives up and returns nullptr once usecs have passed without a node.
+    // Returns nullptr immediately if usecs is 0 and the queue is empty.
+    Node* timedPop(uint64_t usecs)
+    {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(usecs);
+        for (;;)
+        {
+            Node* node = m_queue.tryPop();
+            if (node)
+                return node;
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+                return nullptr;
+            m_consumerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            node = m_queue.tryPop();
+            if (node)
+            {
+                m_consumerWaiting.store(0, std::memory_order_relaxed);
+                return node;
+            }
+            if (!m_event.timedWait(std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count()))
+            {
+                // Timed out. Clear the flag if no producer did. If one did, its signal
+                // just makes a later wait() return early.
+                m_consumerWaiting.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+
+#endif // __CPP11OM_MPSC_QUEUE_H__
@@ -0,0 +1,11 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "pilock.h"
+
+
+#if defined(__linux__)
+CPP11OM_THREAD_LOCAL uint32_t PriorityInheritanceLock::s_tid;
+#endif
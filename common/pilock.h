@@ -0,0 +1,231 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_PI_LOCK_H__
+#define __CPP11OM_PI_LOCK_H__
+
+#include <cassert>
+#include <atomic>
+#include <cstdint>
+
+
+#if defined(__linux__)
+//---------------------------------------------------------
+// PriorityInheritanceLock (Linux)
+// Non-recursive lock for real-time threads. NonRecursiveBenaphore parks waiters on an
+// unowned semaphore, so the kernel can't tell which thread a waiter is blocked behind,
+// and a preempted low-priority owner can stall a high-priority waiter indefinitely.
+// Here, the lock word holds the owner's TID, which is the protocol expected by
+// FUTEX_LOCK_PI: while a thread waits in the kernel, the owner temporarily inherits
+// the waiter's priority.
+// Like the benaphore, uncontended lock() and unlock() never leave user space.
+//---------------------------------------------------------
+
+#include <cerrno>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "threadlocal.h"
+
+class PriorityInheritanceLock
+{
+private:
+    // 0: Unlocked.
+    // Otherwise: TID of the owner. The kernel also sets FUTEX_WAITERS when threads are waiting,
+    // which makes the fast path of unlock() fail and defer to FUTEX_UNLOCK_PI.
+    std::atomic<uint32_t> m_word;
+
+    static CPP11OM_THREAD_LOCAL uint32_t s_tid;
+
+    PriorityInheritanceLock(const PriorityInheritanceLock& other) = delete;
+    PriorityInheritanceLock& operator=(const PriorityInheritanceLock& other) = delete;
+
+    static uint32_t tid()
+    {
+        uint32_t t = s_tid;
+        if (t == 0)
+        {
+            t = (uint32_t) syscall(SYS_gettid);
+            s_tid = t;
+        }
+        return t;
+    }
+
+    long futex(int op)
+    {
+        static_assert(sizeof(m_word) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+        return syscall(SYS_futex, (uint32_t*) &m_word, op, 0, nullptr, nullptr, 0);
+    }
+
+public:
+    PriorityInheritanceLock() : m_word(0) {}
+
+    // False if the kernel lacks PI futexes (CONFIG_FUTEX_PI), in which case lock() can't work.
+    // Probes by unlocking a futex we don't own: a supporting kernel rejects that with EPERM.
+    static bool isSupported()
+    {
+        uint32_t word = 0;
+        long rc = syscall(SYS_futex, &word, FUTEX_UNLOCK_PI_PRIVATE, 0, nullptr, nullptr, 0);
+        return rc != 0 && errno == EPERM;
+    }
+
+    // True while the kernel has waiters queued behind the owner, and is therefore in a position
+    // to boost it. For tests and diagnostics.
+    bool hasKernelWaiters() const
+    {
+        return (m_word.load(std::memory_order_relaxed) & FUTEX_WAITERS) != 0;
+    }
+
+    void lock()
+    {
+        uint32_t expected = 0;
+        if (m_word.compare_exchange_strong(expected, tid(), std::memory_order_acquire, std::memory_order_relaxed))
+            return;
+        assert((expected & FUTEX_TID_MASK) != tid());   // Not recursive
+        // The kernel queues us by priority, boosts the owner, and hands us the lock.
+        while (futex(FUTEX_LOCK_PI_PRIVATE) != 0)
+        {
+            // EAGAIN: The owner is exiting. EINTR shouldn't happen, but is harmless to retry.
+            assert(errno == EAGAIN || errno == EINTR);
+        }
+        // The kernel wrote our TID into m_word. Pair with the release in unlock().
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+
+    bool tryLock()
+    {
+        if (m_word.load(std::memory_order_relaxed) != 0)
+            return false;
+        uint32_t expected = 0;
+        return m_word.compare_exchange_strong(expected, tid(), std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock()
+    {
+        uint32_t expected = tid();
+        if (m_word.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed))
+            return;
+        // There are waiters. The kernel hands the lock to the highest-priority one.
+        assert((expected & FUTEX_TID_MASK) == tid());
+        std::atomic_thread_fence(std::memory_order_release);
+        long rc = futex(FUTEX_UNLOCK_PI_PRIVATE);
+        assert(rc == 0);
+        (void) rc;
+    }
+};
+
+
+#elif defined(__unix__) || defined(__MACH__)
+//---------------------------------------------------------
+// PriorityInheritanceLock (POSIX)
+// Without access to futexes, defer to a pthread mutex with the priority inheritance protocol.
+//---------------------------------------------------------
+
+#include <pthread.h>
+#include <unistd.h>
+
+class PriorityInheritanceLock
+{
+private:
+    pthread_mutex_t m_mutex;
+
+    PriorityInheritanceLock(const PriorityInheritanceLock& other) = delete;
+    PriorityInheritanceLock& operator=(const PriorityInheritanceLock& other) = delete;
+
+public:
+    PriorityInheritanceLock()
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        int rc = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+        assert(rc == 0);    // Priority inheritance is optional in POSIX.
+        rc = pthread_mutex_init(&m_mutex, &attr);
+        assert(rc == 0);
+        (void) rc;
+        pthread_mutexattr_destroy(&attr);
+    }
+
+    static bool isSupported()
+    {
+#if defined(_POSIX_THREAD_PRIO_INHERIT) && _POSIX_THREAD_PRIO_INHERIT > 0
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    ~PriorityInheritanceLock()
+    {
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    void lock()
+    {
+        pthread_mutex_lock(&m_mutex);
+    }
+
+    bool tryLock()
+    {
+        return pthread_mutex_trylock(&m_mutex) == 0;
+    }
+
+    void unlock()
+    {
+        pthread_mutex_unlock(&m_mutex);
+    }
+};
+
+
+#elif defined(_WIN32)
+//---------------------------------------------------------
+// PriorityInheritanceLock (Windows)
+// Windows has no priority-inheriting lock. The closest thing is the scheduler's habit of
+// boosting threads that have been starved for a few seconds, which applies to every lock.
+// This is just a NonRecursiveBenaphore, so that portable code still builds.
+//---------------------------------------------------------
+
+#include "benaphore.h"
+
+class PriorityInheritanceLock
+{
+private:
+    NonRecursiveBenaphore m_benaphore;
+
+    PriorityInheritanceLock(const PriorityInheritanceLock& other) = delete;
+    PriorityInheritanceLock& operator=(const PriorityInheritanceLock& other) = delete;
+
+public:
+    PriorityInheritanceLock() {}
+
+    static bool isSupported()
+    {
+        return false;
+    }
+
+    void lock()
+    {
+        m_benaphore.lock();
+    }
+
+    bool tryLock()
+    {
+        return m_benaphore.tryLock();
+    }
+
+    void unlock()
+    {
+        m_benaphore.unlock();
+    }
+};
+
+
+#else
+
+#error Unsupported platform!
+
+#endif
+
+
+#endif // __CPP11OM_PI_LOCK_H__
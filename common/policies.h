@@ -0,0 +1,302 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_POLICIES_H__
+#define __CPP11OM_POLICIES_H__
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include "threadrunstate.h"
+
+
+//---------------------------------------------------------
+// Policies
+// Compile-time options for the primitives. Each primitive has a Basic* template that takes
+// them as parameters, and the familiar name (NonRecursiveBenaphore, LightweightSemaphore,
+// and so on) is an alias for the default combination. For example, a lock that waits on a
+// futex without spinning and counts contention:
+//
+//     typedef BasicLightweightSemaphore<FutexSemaphore, NoSpin> NoSpinFutexSemaphore;
+//     BasicNonRecursiveBenaphore<NoSpinFutexSemaphore, ContentionStats> lock;
+//
+// Primitives inherit privately from their policies, so empty policies take no space,
+// and a policy that does nothing compiles away entirely.
+//---------------------------------------------------------
+
+
+//---------------------------------------------------------
+// Spin policies
+// How long BasicLightweightSemaphore spins before it asks the kernel to put the thread to sleep.
+// spinCount() is read before each wait, and onSpinResult() is told whether the spin paid off.
+//---------------------------------------------------------
+template <int SpinCount>
+struct FixedSpin
+{
+    int spinCount() const
+    {
+        return SpinCount;
+    }
+
+    void onSpinResult(bool succeeded)
+    {
+        (void) succeeded;
+    }
+};
+
+// Go straight to the kernel. Best when waits are long, or when there's one core per several threads.
+typedef FixedSpin<0> NoSpin;
+
+// Is there a better way to set the initial spin count?
+// If we lower it to 1000, testBenaphore becomes 15x slower on my Core i7-5930K Windows PC,
+// as threads start hitting the kernel semaphore.
+typedef FixedSpin<10000> DefaultSpin;
+
+// Grows the spin count while spinning succeeds, and shrinks it while the thread ends up
+// sleeping anyway, within [MIN_SPIN, MAX_SPIN]. The count is shared by every thread waiting
+// on the same object. Updates are racy, which only makes the adaptation a little noisier.
+class AdaptiveSpin
+{
+private:
+    static const int MIN_SPIN = 100;
+    static const int MAX_SPIN = 20000;
+
+    std::atomic<int> m_spinCount;
+
+public:
+    AdaptiveSpin() : m_spinCount(2000) {}
+
+    int spinCount() const
+    {
+        return m_spinCount.load(std::memory_order_relaxed);
+    }
+
+    void onSpinResult(bool succeeded)
+    {
+        int count = m_spinCount.load(std::memory_order_relaxed);
+        if (succeeded)
+            count = count + count / 8 < MAX_SPIN ? count + count / 8 : MAX_SPIN;
+        else
+            count = count - count / 8 > MIN_SPIN ? count - count / 8 : MIN_SPIN;
+        m_spinCount.store(count, std::memory_order_relaxed);
+    }
+};
+
+
+//---------------------------------------------------------
+// Owner spin policies
+// Whether a thread that finds a benaphore locked spins until the owner unlocks it, instead of
+// queueing on the semaphore right away. The lock calls onAcquired() each time a thread takes
+// it, beginSpin() before spinning, and keepSpinning() on every iteration. Combine with a
+// NoSpin semaphore, so that a thread that does queue goes straight to sleep.
+//---------------------------------------------------------
+struct NoOwnerSpin
+{
+    void onAcquired() {}
+    bool beginSpin() { return false; }
+    bool keepSpinning(int iteration) { (void) iteration; return false; }
+};
+
+// Records the owner, and stops spinning as soon as the owner is parked (see ThreadRunState),
+// since it won't unlock until something else wakes it. This is how the Linux kernel's
+// mutexes spin, except that the kernel can also see when the owner has been preempted.
+// Never spins on a single core, where the owner can't run while we spin.
+template <int MaxSpin = 10000>
+class OwnerAwareSpin
+{
+private:
+    std::atomic<int> m_owner;     // ThreadRunState index of the last thread to take the lock
+
+public:
+    OwnerAwareSpin() : m_owner(ThreadRunState::NO_INDEX)
+    {
+        ThreadRunState::enable();
+    }
+
+    void onAcquired()
+    {
+        m_owner.store(ThreadRunState::currentIndex(), std::memory_order_relaxed);
+    }
+
+    bool beginSpin()
+    {
+        return ThreadRunState::isMultiCore();
+    }
+
+    bool keepSpinning(int iteration)
+    {
+        if (iteration >= MaxSpin)
+            return false;
+        // The owner's flag is on another cache line, so don't check it on every iteration.
+        // Right after a handoff, m_owner may still name the previous owner. That's harmless.
+        if ((iteration & 15) == 0 && !ThreadRunState::isRunning(m_owner.load(std::memory_order_relaxed)))
+            return false;
+        return true;
+    }
+};
+
+
+//---------------------------------------------------------
+// Stats policies
+// Primitives report how each wait or lock went:
+// - onUncontended(): Got in without waiting.
+// - onSpinSuccess(): Had to wait, but got in while spinning in user space.
+// - onKernelWait(): Had to sleep in the kernel (or, for locks, on a semaphore).
+//---------------------------------------------------------
+struct NoStats
+{
+    void onUncontended() {}
+    void onSpinSuccess() {}
+    void onKernelWait() {}
+};
+
+// Counts each kind of wait with relaxed atomic increments. They're cheap, but they do
+// write to a shared cache line on every operation, so don't leave this on everywhere.
+class ContentionStats
+{
+private:
+    std::atomic<uint64_t> m_uncontended;
+    std::atomic<uint64_t> m_spinSuccesses;
+    std::atomic<uint64_t> m_kernelWaits;
+
+public:
+    ContentionStats() : m_uncontended(0), m_spinSuccesses(0), m_kernelWaits(0) {}
+
+    void onUncontended() { m_uncontended.fetch_add(1, std::memory_order_relaxed); }
+    void onSpinSuccess() { m_spinSuccesses.fetch_add(1, std::memory_order_relaxed); }
+    void onKernelWait() { m_kernelWaits.fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t uncontended() const { return m_uncontended.load(std::memory_order_relaxed); }
+    uint64_t spinSuccesses() const { return m_spinSuccesses.load(std::memory_order_relaxed); }
+    uint64_t kernelWaits() const { return m_kernelWaits.load(std::memory_order_relaxed); }
+};
+
+
+//---------------------------------------------------------
+// Wake policies
+// How BasicLightweightSemaphore::signal() hands wake-ups to the kernel semaphore, once it has
+// counted how many sleeping threads to release. wake() must eventually call sema.signal() with
+// every unit it's given, in total, but may combine or defer them. onWoken() is called by each
+// thread that took a unit from sema, once it's running again.
+//---------------------------------------------------------
+
+// Each signal() makes its own kernel call.
+struct DirectWake
+{
+    template <class SemaphoreType>
+    void wake(SemaphoreType& sema, int count)
+    {
+        sema.signal(count);
+    }
+
+    template <class SemaphoreType>
+    void onWoken(SemaphoreType& sema)
+    {
+        (void) sema;
+    }
+};
+
+// Coalesces the wake-ups of concurrent signalers. The first one to find m_pendingWakes at 0
+// is elected, and keeps calling sema.signal() with whatever has accumulated until it drains to 0.
+// The others just add their count and return without entering the kernel. During a burst,
+// many wake-ups ride along on each of the elected thread's kernel calls.
+// Only pays off when sema.signal(n) is a single kernel call: FutexSemaphore, EventfdSemaphore,
+// and the Windows Semaphore. POSIX and Mach semaphores signal one unit at a time.
+class CoalescedWake
+{
+private:
+    std::atomic<int> m_pendingWakes;
+
+public:
+    CoalescedWake() : m_pendingWakes(0) {}
+
+    template <class SemaphoreType>
+    void wake(SemaphoreType& sema, int count)
+    {
+        if (m_pendingWakes.fetch_add(count, std::memory_order_relaxed) != 0)
+            return;     // The elected signaler will pick up our count.
+        int pending = m_pendingWakes.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            sema.signal(pending);
+            // Release the units we've handed over. If more arrived meanwhile, they're ours too.
+            int remaining = m_pendingWakes.fetch_sub(pending, std::memory_order_relaxed) - pending;
+            assert(remaining >= 0);
+            if (remaining == 0)
+                break;
+            pending = remaining;
+        }
+    }
+
+    template <class SemaphoreType>
+    void onWoken(SemaphoreType& sema)
+    {
+        (void) sema;
+    }
+};
+
+// Baton passing: wake() releases only one thread, and leaves a baton for each of the others.
+// Each woken thread, once it's running, takes a baton if there is one and releases the next
+// thread. Waking N threads takes N sequential wake-ups instead of one broadcast, but they
+// become runnable one at a time rather than stampeding the run queue together, which helps
+// when they all go on to contend for something else, as readers released by a writer often do.
+// Batons aren't tied to a particular wake(); whichever thread wakes next passes one on.
+class CascadingWake
+{
+private:
+    std::atomic<int> m_batons;
+
+public:
+    CascadingWake() : m_batons(0) {}
+
+    template <class SemaphoreType>
+    void wake(SemaphoreType& sema, int count)
+    {
+        // Add the batons before the signal, so that the thread it wakes will find them.
+        if (count > 1)
+            m_batons.fetch_add(count - 1, std::memory_order_relaxed);
+        sema.signal(1);
+    }
+
+    template <class SemaphoreType>
+    void onWoken(SemaphoreType& sema)
+    {
+        int batons = m_batons.load(std::memory_order_relaxed);
+        while (batons > 0)
+        {
+            // On failure, batons will be updated with the latest value.
+            if (m_batons.compare_exchange_weak(batons, batons - 1, std::memory_order_relaxed))
+            {
+                sema.signal(1);
+                return;
+            }
+        }
+    }
+};
+
+
+//---------------------------------------------------------
+// Alignment policies
+// CacheLineAlignment aligns and pads the primitive to its own cache line, so that
+// neighboring objects, such as other elements of an array, don't share it.
+// Before C++17, operator new doesn't honor over-alignment, so heap-allocated objects are
+// only padded, not aligned, unless you allocate them with an aligned allocator yourself.
+//---------------------------------------------------------
+#if defined(_MSC_VER)
+#define CPP11OM_ALIGN(n) __declspec(align(n))
+#else
+#define CPP11OM_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+struct NoAlignment
+{
+};
+
+struct CPP11OM_ALIGN(64) CacheLineAlignment
+{
+};
+
+
+#endif // __CPP11OM_POLICIES_H__
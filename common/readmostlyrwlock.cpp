@@ -0,0 +1,26 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "readmostlyrwlock.h"
+
+
+CPP11OM_THREAD_LOCAL int ReadMostlyRWLock::s_threadIndexPlusOne;
+ThreadSlotBitmap<ReadMostlyRWLock::MAX_FAST_READERS> ReadMostlyRWLock::s_usedSlots;
+
+int ReadMostlyRWLock::claimIndex()
+{
+    int index = s_usedSlots.claim();
+    if (index >= 0)
+        ThreadExitHook::add(releaseIndex, index);
+    return index;
+}
+
+void ReadMostlyRWLock::releaseIndex(int index)
+{
+    // The thread can't be holding a read lock as it exits, so its slot is idle in every lock.
+    // Any read lock taken after this point, such as from another TLS destructor, takes the slow path.
+    s_threadIndexPlusOne = -1;
+    s_usedSlots.release(index);
+}
@@ -0,0 +1,157 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_READ_MOSTLY_RWLOCK_H__
+#define __CPP11OM_READ_MOSTLY_RWLOCK_H__
+
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include "rwlock.h"
+#include "asymmetricfence.h"
+#include "threadlocal.h"
+#include "threadslots.h"
+
+
+//---------------------------------------------------------
+// ReadMostlyRWLock
+// Same interface as NonRecursiveRWLock, for data that is read far more often than written.
+// Each reader thread announces itself in its own cache line, so readers never write to a
+// shared location, and uses AsymmetricFence::light() instead of a full fence before
+// checking for a writer. Writers pay for that with AsymmetricFence::heavy() and a scan
+// of every reader slot.
+// Up to MAX_FAST_READERS threads at a time (process-wide) get a private slot the first time
+// they take a read lock, and give it back when they exit. Threads beyond that always take
+// the slow path, which is an ordinary NonRecursiveRWLock.
+// Takes MAX_FAST_READERS cache lines of memory per lock.
+//---------------------------------------------------------
+class ReadMostlyRWLock
+{
+private:
+    static const int MAX_FAST_READERS = 64;
+    static const int CACHE_LINE_SIZE = 64;
+
+    struct ReaderSlot
+    {
+        std::atomic<int> isReading;
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<int>)];
+
+        ReaderSlot() : isReading(0) {}
+    };
+
+    static CPP11OM_THREAD_LOCAL int s_threadIndexPlusOne;    // 0 until the thread asks; -1 if it got no slot
+    static ThreadSlotBitmap<MAX_FAST_READERS> s_usedSlots;
+
+    ReaderSlot m_slots[MAX_FAST_READERS];
+    std::atomic<int> m_writerActive;
+    // Serializes writers. Readers also wait here while a writer is active.
+    NonRecursiveRWLock m_rwLock;
+
+    // Same scheme as ThreadRunState.
+    static int claimIndex();
+    static void releaseIndex(int index);
+
+    // Returns -1 if the calling thread has no slot.
+    static int threadIndex()
+    {
+        int plusOne = s_threadIndexPlusOne;
+        if (plusOne == 0)
+        {
+            int index = claimIndex();
+            plusOne = index >= 0 ? index + 1 : -1;
+            s_threadIndexPlusOne = plusOne;
+        }
+        return plusOne > 0 ? plusOne - 1 : -1;
+    }
+
+public:
+    ReadMostlyRWLock() : m_writerActive(0) {}
+
+    // True if the calling thread's read locks take the fast path.
+    static bool hasReaderSlot()
+    {
+        return threadIndex() >= 0;
+    }
+
+    void lockReader()
+    {
+        int index = threadIndex();
+        if (index >= 0)
+        {
+            ReaderSlot& slot = m_slots[index];
+            assert(slot.isReading.load(std::memory_order_relaxed) == 0);   // Not recursive
+            slot.isReading.store(1, std::memory_order_relaxed);
+            // Order the store above before the load below. Pairs with heavy() in lockWriter.
+            AsymmetricFence::light();
+            if (m_writerActive.load(std::memory_order_acquire) == 0)
+                return;
+
+            // A writer is active. Back out, wait for it to finish, then announce
+            // ourselves again while holding off any new writers.
+            slot.isReading.store(0, std::memory_order_relaxed);
+            m_rwLock.lockReader();
+            slot.isReading.store(1, std::memory_order_relaxed);
+            m_rwLock.unlockReader();
+        }
+        else
+        {
+            m_rwLock.lockReader();
+        }
+    }
+
+    void unlockReader()
+    {
+        int index = threadIndex();
+        if (index >= 0)
+        {
+            assert(m_slots[index].isReading.load(std::memory_order_relaxed) == 1);
+            m_slots[index].isReading.store(0, std::memory_order_release);
+        }
+        else
+        {
+            m_rwLock.unlockReader();
+        }
+    }
+
+    void lockWriter()
+    {
+        m_rwLock.lockWriter();
+        m_writerActive.store(1, std::memory_order_relaxed);
+        // Either each reader sees m_writerActive, or we see its slot. Pairs with light() in lockReader.
+        AsymmetricFence::heavy();
+        // Writers are rare, so just poll until the fast readers drain.
+        for (int i = 0; i < MAX_FAST_READERS; i++)
+        {
+            int spin = 0;
+            while (m_slots[i].isReading.load(std::memory_order_acquire) != 0)
+            {
+                if (++spin < 1000)
+                    std::atomic_signal_fence(std::memory_order_acquire);    // Prevent the compiler from collapsing the loop.
+                else
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlockWriter()
+    {
+        m_writerActive.store(0, std::memory_order_release);
+        m_rwLock.unlockWriter();
+    }
+
+    // Writers always go through m_rwLock, so its version covers optimistic reads too.
+    uint32_t tryOptimisticRead()
+    {
+        return m_rwLock.tryOptimisticRead();
+    }
+
+    bool validate(uint32_t stamp)
+    {
+        return m_rwLock.validate(stamp);
+    }
+};
+
+
+#endif // __CPP11OM_READ_MOSTLY_RWLOCK_H__
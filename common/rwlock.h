@@ -15,8 +15,14 @@
 
 //---------------------------------------------------------
 // NonRecursiveRWLock
+// Also supports optimistic reads, like Java's StampedLock:
+// tryOptimisticRead() returns a stamp without writing to shared memory,
+// and validate(stamp) returns false if a writer may have intervened since.
+// See optimisticRead (below) for a convenient way to use them.
+// Template parameters are as for BasicNonRecursiveBenaphore. Use the NonRecursiveRWLock alias (below).
 //---------------------------------------------------------
-class NonRecursiveRWLock
+template <class SemaphoreType = DefaultSemaphoreType, class StatsPolicy = NoStats, class AlignmentPolicy = NoAlignment>
+class BasicNonRecursiveRWLock : private StatsPolicy, private AlignmentPolicy
 {
 private:
     BEGIN_BITFIELD_TYPE(Status, uint32_t)
@@ -26,11 +32,14 @@ private:
     END_BITFIELD_TYPE()
 
     std::atomic<uint32_t> m_status;
-    DefaultSemaphoreType m_readSema;
-    DefaultSemaphoreType m_writeSema;
+    // Seqlock-style version for optimistic readers. Odd while a writer holds the lock.
+    // Only the writer holding the lock modifies it.
+    std::atomic<uint32_t> m_version;
+    SemaphoreType m_readSema;
+    SemaphoreType m_writeSema;
 
 public:
-    NonRecursiveRWLock() : m_status(0) {}
+    BasicNonRecursiveRWLock() : m_status(0), m_version(0) {}
     
     void lockReader()
     {
@@ -54,8 +63,13 @@ public:
 
         if (oldStatus.writers > 0)
         {
+            StatsPolicy::onKernelWait();
             m_readSema.wait();
         }
+        else
+        {
+            StatsPolicy::onUncontended();
+        }
     }
 
     void unlockReader()
@@ -74,12 +88,22 @@ public:
         assert(oldStatus.writers + 1 <= Status().writers.maximum());
         if (oldStatus.readers > 0 || oldStatus.writers > 0)
         {
+            StatsPolicy::onKernelWait();
             m_writeSema.wait();
         }
+        else
+        {
+            StatsPolicy::onUncontended();
+        }
+        //--- We are now inside the lock ---
+        m_version.store(m_version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // Order the odd version before any writes to the protected data.
+        std::atomic_thread_fence(std::memory_order_release);
     }
 
     void unlockWriter()
     {
+        m_version.store(m_version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
         Status oldStatus = m_status.load(std::memory_order_relaxed);
         Status newStatus;
         uint32_t waitToRead = 0;
@@ -108,8 +132,28 @@ public:
             m_writeSema.signal();
         }
     }
+
+    uint32_t tryOptimisticRead()
+    {
+        return m_version.load(std::memory_order_acquire);
+    }
+
+    // Call after reading the protected data, before trusting it.
+    bool validate(uint32_t stamp)
+    {
+        // Order the data reads before the version check.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return (stamp & 1) == 0 && m_version.load(std::memory_order_relaxed) == stamp;
+    }
+
+    const StatsPolicy& stats() const
+    {
+        return *this;
+    }
 };
 
+typedef BasicNonRecursiveRWLock<> NonRecursiveRWLock;
+
 
 //---------------------------------------------------------
 // ReadLockGuard
@@ -155,4 +199,31 @@ public:
 };
 
 
+//---------------------------------------------------------
+// optimisticRead
+// Calls readFunc without locking, then again inside a read lock if a writer may
+// have intervened. readFunc must tolerate reading torn data on the first call,
+// and should only copy it somewhere that the second call will overwrite.
+// Strictly speaking, the protected data must be accessed through relaxed atomics
+// for the first call to be free of data races.
+//---------------------------------------------------------
+template <class LockType, class ReadFunc>
+void optimisticRead(LockType& lock, const ReadFunc& readFunc)
+{
+    uint32_t stamp = lock.tryOptimisticRead();
+    if (stamp & 1)
+    {
+        ReadLockGuard<LockType> guard(lock);   // A writer is active; don't bother.
+        readFunc();
+        return;
+    }
+    readFunc();
+    if (!lock.validate(stamp))
+    {
+        ReadLockGuard<LockType> guard(lock);
+        readFunc();
+    }
+}
+
+
 #endif // __CPP11OM_RWLOCK_H__
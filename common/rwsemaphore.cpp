@@ -0,0 +1,124 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "rwsemaphore.h"
+
+
+bool RWSemaphore::acquireSlow(int count, int64_t timeoutUsecs)
+{
+    assert(count > 0 && count <= m_maxPermits);
+    Waiter waiter;
+    waiter.count = count;
+    waiter.granted = false;
+    waiter.next = nullptr;
+
+    m_waitersLock.lock();
+    Status oldStatus = m_status.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Status newStatus = oldStatus;
+        if (!oldStatus.hasWaiters && oldStatus.available >= (uint32_t) count)
+        {
+            // Permits were released since tryAcquire() failed.
+            newStatus.available -= count;
+            if (m_status.compare_exchange_weak(oldStatus, newStatus, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                m_waitersLock.unlock();
+                return true;
+            }
+        }
+        else
+        {
+            // Disable the fast paths, so that every release() comes through releaseSlow().
+            newStatus.hasWaiters = 1;
+            if (m_status.compare_exchange_weak(oldStatus, newStatus, std::memory_order_relaxed, std::memory_order_relaxed))
+                break;
+        }
+    }
+    waiter.prev = m_tail;
+    if (m_tail)
+        m_tail->next = &waiter;
+    else
+        m_head = &waiter;
+    m_tail = &waiter;
+    m_waitersLock.unlock();
+
+    if (timeoutUsecs < 0)
+    {
+        waiter.sema.wait();
+    }
+    else if (!waiter.sema.timedWait((uint64_t) timeoutUsecs))
+    {
+        // Timed out. Back out, unless we were granted in the meantime.
+        m_waitersLock.lock();
+        if (!waiter.granted)
+        {
+            bool wasHead = (m_head == &waiter);
+            unlinkWaiter(&waiter);
+            // If we were blocking the head of the queue, the waiters behind us may fit now.
+            // grantWaiters() also re-enables the fast paths if the queue is now empty.
+            if (wasHead)
+                grantWaiters(m_status.load(std::memory_order_relaxed));
+            m_waitersLock.unlock();
+            return false;
+        }
+        m_waitersLock.unlock();
+        waiter.sema.wait();     // granted was set along with the signal, so this returns promptly.
+    }
+    // The semaphore synchronizes-with the thread that granted us the permits.
+    return true;
+}
+
+void RWSemaphore::releaseSlow(int count)
+{
+    m_waitersLock.lock();
+    Status status = m_status.load(std::memory_order_relaxed);
+    while (!status.hasWaiters)
+    {
+        // The last waiter timed out since release() checked, so the fast paths are back on.
+        Status newStatus = status;
+        newStatus.available += count;
+        if (m_status.compare_exchange_weak(status, newStatus, std::memory_order_release, std::memory_order_relaxed))
+        {
+            m_waitersLock.unlock();
+            return;
+        }
+    }
+    // Only threads holding m_waitersLock modify m_status while hasWaiters is set.
+    status.available += count;
+    assert(status.available <= (uint32_t) m_maxPermits);
+    grantWaiters(status);
+    m_waitersLock.unlock();
+}
+
+void RWSemaphore::unlinkWaiter(Waiter* waiter)
+{
+    if (waiter->prev)
+        waiter->prev->next = waiter->next;
+    else
+        m_head = waiter->next;
+    if (waiter->next)
+        waiter->next->prev = waiter->prev;
+    else
+        m_tail = waiter->prev;
+}
+
+// Must hold m_waitersLock, with hasWaiters set in status.
+void RWSemaphore::grantWaiters(Status status)
+{
+    while (m_head && (uint32_t) m_head->count <= status.available)
+    {
+        Waiter* waiter = m_head;
+        status.available -= waiter->count;
+        unlinkWaiter(waiter);
+        waiter->granted = true;
+        // A semaphore may be destroyed as soon as a wait on it returns, so it's OK that
+        // waiter's stack frame might be gone before this call returns.
+        waiter->sema.signal();
+    }
+    if (!m_head)
+        status.hasWaiters = 0;
+    m_status.store(status, std::memory_order_release);
+}
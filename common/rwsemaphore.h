@@ -0,0 +1,132 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_RW_SEMAPHORE_H__
+#define __CPP11OM_RW_SEMAPHORE_H__
+
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include "sema.h"
+#include "benaphore.h"
+#include "bitfield.h"
+
+
+//---------------------------------------------------------
+// RWSemaphore
+// Counting semaphore with a fixed number of permits, where exclusive access simply means
+// holding all of them. For example, up to N reads can be in flight to a device at once,
+// while compaction drains them all and runs alone.
+// acquire(count) takes a batch of permits atomically. Waiters are admitted in FIFO order,
+// so a pending exclusive request holds off new readers instead of starving behind them,
+// and when it releases, every queued request that fits is admitted at once.
+// Also has the lockReader/unlockReader/lockWriter/unlockWriter interface, with a reader
+// holding one permit, so it works with ReadLockGuard and WriteLockGuard.
+// Uncontended acquire() and release() are a single CAS. Once a request has to wait,
+// the slow path goes through an internal lock, and each waiter parks on its own semaphore,
+// which lets it back out cleanly when a timeout expires.
+//---------------------------------------------------------
+class RWSemaphore
+{
+private:
+    BEGIN_BITFIELD_TYPE(Status, uint32_t)
+        ADD_BITFIELD_MEMBER(available, 0, 31)
+        ADD_BITFIELD_MEMBER(hasWaiters, 31, 1)  // Fast paths are disabled while set
+    END_BITFIELD_TYPE()
+
+    struct Waiter
+    {
+        int count;
+        bool granted;
+        Waiter* prev;
+        Waiter* next;
+        DefaultSemaphoreType sema;
+    };
+
+    std::atomic<uint32_t> m_status;
+    int m_maxPermits;
+    // Protects the waiter list. While it's non-empty, only threads holding this lock modify m_status.
+    NonRecursiveBenaphore m_waitersLock;
+    Waiter* m_head;
+    Waiter* m_tail;
+
+    RWSemaphore(const RWSemaphore& other) = delete;
+    RWSemaphore& operator=(const RWSemaphore& other) = delete;
+
+    bool acquireSlow(int count, int64_t timeoutUsecs);
+    void releaseSlow(int count);
+    void unlinkWaiter(Waiter* waiter);
+    void grantWaiters(Status status);
+
+public:
+    RWSemaphore(int maxPermits) : m_status(0), m_maxPermits(maxPermits), m_head(nullptr), m_tail(nullptr)
+    {
+        assert(maxPermits > 0 && (uint32_t) maxPermits <= Status().available.maximum());
+        Status status;
+        status.available = maxPermits;
+        m_status.store(status, std::memory_order_relaxed);
+    }
+
+    ~RWSemaphore()
+    {
+        assert(m_head == nullptr);
+    }
+
+    int maxPermits() const
+    {
+        return m_maxPermits;
+    }
+
+    bool tryAcquire(int count = 1)
+    {
+        assert(count > 0 && count <= m_maxPermits);
+        Status oldStatus = m_status.load(std::memory_order_relaxed);
+        while (!oldStatus.hasWaiters && oldStatus.available >= (uint32_t) count)
+        {
+            Status newStatus = oldStatus;
+            newStatus.available -= count;
+            // On failure, oldStatus will be updated with the latest value.
+            if (m_status.compare_exchange_weak(oldStatus, newStatus, std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
+    void acquire(int count = 1)
+    {
+        if (!tryAcquire(count))
+            acquireSlow(count, -1);
+    }
+
+    // Returns false if the permits couldn't be acquired within usecs.
+    bool timedAcquire(int count, uint64_t usecs)
+    {
+        return tryAcquire(count) || acquireSlow(count, (int64_t) usecs);
+    }
+
+    void release(int count = 1)
+    {
+        assert(count > 0 && count <= m_maxPermits);
+        Status oldStatus = m_status.load(std::memory_order_relaxed);
+        while (!oldStatus.hasWaiters)
+        {
+            Status newStatus = oldStatus;
+            newStatus.available += count;
+            assert(newStatus.available <= (uint32_t) m_maxPermits);
+            if (m_status.compare_exchange_weak(oldStatus, newStatus, std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
+        releaseSlow(count);
+    }
+
+    void lockReader() { acquire(1); }
+    void unlockReader() { release(1); }
+    void lockWriter() { acquire(m_maxPermits); }
+    bool timedLockWriter(uint64_t usecs) { return timedAcquire(m_maxPermits, usecs); }
+    void unlockWriter() { release(m_maxPermits); }
+};
+
+
+#endif // __CPP11OM_RW_SEMAPHORE_H__
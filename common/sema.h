@@ -8,6 +8,9 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
+#include "policies.h"
+#include "threadrunstate.h"
 
 
 #if defined(_WIN32)
@@ -44,6 +47,12 @@ public:
         WaitForSingleObject(m_hSema, INFINITE);
     }
 
+    bool timedWait(uint64_t usecs)
+    {
+        DWORD millis = (DWORD) ((usecs + 999) / 1000);
+        return WaitForSingleObject(m_hSema, millis < INFINITE ? millis : INFINITE - 1) == WAIT_OBJECT_0;
+    }
+
     void signal(int count = 1)
     {
         ReleaseSemaphore(m_hSema, count, NULL);
@@ -84,6 +93,15 @@ public:
         semaphore_wait(m_sema);
     }
 
+    bool timedWait(uint64_t usecs)
+    {
+        mach_timespec_t ts;
+        ts.tv_sec = (unsigned int) (usecs / 1000000);
+        ts.tv_nsec = (clock_res_t) ((usecs % 1000000) * 1000);
+        // semaphore_timedwait can also be interrupted, in which case we report a timeout.
+        return semaphore_timedwait(m_sema, ts) == KERN_SUCCESS;
+    }
+
     void signal()
     {
         semaphore_signal(m_sema);
@@ -105,6 +123,8 @@ public:
 //---------------------------------------------------------
 
 #include <semaphore.h>
+#include <time.h>
+#include <cerrno>
 
 class Semaphore
 {
@@ -137,6 +157,23 @@ public:
         while (rc == -1 && errno == EINTR);
     }
 
+    bool timedWait(uint64_t usecs)
+    {
+        // sem_timedwait takes an absolute time on CLOCK_REALTIME.
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t nsecs = (uint64_t) ts.tv_nsec + (usecs % 1000000) * 1000;
+        ts.tv_sec += (time_t) (usecs / 1000000 + nsecs / 1000000000);
+        ts.tv_nsec = (long) (nsecs % 1000000000);
+        int rc;
+        do
+        {
+            rc = sem_timedwait(&m_sema, &ts);
+        }
+        while (rc == -1 && errno == EINTR);
+        return rc == 0;
+    }
+
     void signal()
     {
         sem_post(&m_sema);
@@ -152,6 +189,221 @@ public:
 };
 
 
+
+
+#if defined(__linux__)
+//---------------------------------------------------------
+// EventfdSemaphore (Linux)
+// Same interface as Semaphore, but built on eventfd(EFD_SEMAPHORE), so that fd() can be
+// watched with poll, epoll or io_uring alongside sockets and other files. It's readable
+// while the count is positive. After it polls readable, call tryWait() to take the unit.
+// Another thread waiting on the same semaphore may take it first, so be ready for that to fail.
+// The fd is non-blocking, so wait() costs an extra ppoll() compared to sem_wait().
+//---------------------------------------------------------
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+class EventfdSemaphore
+{
+private:
+    int m_fd;
+
+    EventfdSemaphore(const EventfdSemaphore& other) = delete;
+    EventfdSemaphore& operator=(const EventfdSemaphore& other) = delete;
+
+    // A null timeout means wait forever.
+    void waitReadable(const struct timespec* timeout)
+    {
+        struct pollfd pfd;
+        pfd.fd = m_fd;
+        pfd.events = POLLIN;
+        ppoll(&pfd, 1, timeout, nullptr);   // On EINTR, the caller just loops around.
+    }
+
+public:
+    EventfdSemaphore(int initialCount = 0)
+    {
+        assert(initialCount >= 0);
+        m_fd = eventfd(initialCount, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+        assert(m_fd >= 0);
+    }
+
+    ~EventfdSemaphore()
+    {
+        close(m_fd);
+    }
+
+    int fd() const
+    {
+        return m_fd;
+    }
+
+    bool tryWait()
+    {
+        uint64_t value;
+        ssize_t rc;
+        do
+        {
+            rc = read(m_fd, &value, sizeof(value));
+        }
+        while (rc == -1 && errno == EINTR);
+        return rc == sizeof(value);
+    }
+
+    void wait()
+    {
+        while (!tryWait())
+            waitReadable(nullptr);
+    }
+
+    bool timedWait(uint64_t usecs)
+    {
+        struct timespec now, deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        uint64_t nsecs = (uint64_t) deadline.tv_nsec + (usecs % 1000000) * 1000;
+        deadline.tv_sec += (time_t) (usecs / 1000000 + nsecs / 1000000000);
+        deadline.tv_nsec = (long) (nsecs % 1000000000);
+        while (!tryWait())
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))
+                return false;
+            struct timespec remaining;
+            remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+            remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if (remaining.tv_nsec < 0)
+            {
+                remaining.tv_sec--;
+                remaining.tv_nsec += 1000000000;
+            }
+            waitReadable(&remaining);
+        }
+        return true;
+    }
+
+    void signal(int count = 1)
+    {
+        uint64_t value = count;
+        ssize_t rc;
+        do
+        {
+            rc = write(m_fd, &value, sizeof(value));
+        }
+        while (rc == -1 && errno == EINTR);
+        assert(rc == sizeof(value));
+    }
+};
+
+
+//---------------------------------------------------------
+// FutexSemaphore (Linux)
+// Same interface as Semaphore: a count in user space, with FUTEX_WAIT/FUTEX_WAKE on it.
+// Waiters are counted separately, so that signal() only makes a FUTEX_WAKE syscall when
+// somebody might be sleeping, like sem_post().
+// futexWord() exposes the count, so that io_uring can wait on it directly with
+// IORING_OP_FUTEX_WAIT, while it's 0. Bracket such waits with addWaiter() and removeWaiter(),
+// and after the wait completes, call tryWait() to take a unit.
+//---------------------------------------------------------
+
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+class FutexSemaphore
+{
+private:
+    std::atomic<uint32_t> m_count;
+    std::atomic<int> m_waiters;     // Threads (or rings) that may be blocked on m_count.
+
+    FutexSemaphore(const FutexSemaphore& other) = delete;
+    FutexSemaphore& operator=(const FutexSemaphore& other) = delete;
+
+    long futex(int op, uint32_t val, const struct timespec* timeout, uint32_t val3)
+    {
+        static_assert(sizeof(m_count) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+        return syscall(SYS_futex, (uint32_t*) &m_count, op, val, timeout, nullptr, val3);
+    }
+
+public:
+    FutexSemaphore(int initialCount = 0) : m_count(initialCount), m_waiters(0)
+    {
+        assert(initialCount >= 0);
+    }
+
+    std::atomic<uint32_t>* futexWord()
+    {
+        return &m_count;
+    }
+
+    bool tryWait()
+    {
+        uint32_t count = m_count.load(std::memory_order_relaxed);
+        while (count > 0)
+        {
+            // On failure, count will be updated with the latest value.
+            if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
+    // Announces a wait on futexWord() by someone other than wait() and timedWait(), such as an
+    // io_uring. Call before the wait is submitted; the submitting syscall orders the two.
+    void addWaiter()
+    {
+        // Dekker-style with signal(): either we see its increment of m_count, or it sees ours
+        // of m_waiters. Both sides are seq_cst.
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void removeWaiter()
+    {
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wait()
+    {
+        while (!tryWait())
+        {
+            addWaiter();
+            if (m_count.load(std::memory_order_seq_cst) == 0)
+                futex(FUTEX_WAIT_PRIVATE, 0, nullptr, 0);     // Returns immediately if m_count is no longer 0.
+            removeWaiter();
+        }
+    }
+
+    bool timedWait(uint64_t usecs)
+    {
+        // FUTEX_WAIT_BITSET takes an absolute deadline on CLOCK_MONOTONIC, which survives spurious wakeups.
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        uint64_t nsecs = (uint64_t) deadline.tv_nsec + (usecs % 1000000) * 1000;
+        deadline.tv_sec += (time_t) (usecs / 1000000 + nsecs / 1000000000);
+        deadline.tv_nsec = (long) (nsecs % 1000000000);
+        while (!tryWait())
+        {
+            addWaiter();
+            bool timedOut = false;
+            if (m_count.load(std::memory_order_seq_cst) == 0)
+                timedOut = (futex(FUTEX_WAIT_BITSET_PRIVATE, 0, &deadline, FUTEX_BITSET_MATCH_ANY) == -1 && errno == ETIMEDOUT);
+            removeWaiter();
+            if (timedOut)
+                return tryWait();
+        }
+        return true;
+    }
+
+    void signal(int count = 1)
+    {
+        m_count.fetch_add(count, std::memory_order_seq_cst);
+        // Skip the syscall when nobody can be asleep. See addWaiter().
+        if (m_waiters.load(std::memory_order_seq_cst) > 0)
+            futex(FUTEX_WAKE_PRIVATE, count, nullptr, 0);
+    }
+};
+#endif
+
 #else
 
 #error Unsupported platform!
@@ -160,37 +412,107 @@ public:
 
 
 //---------------------------------------------------------
-// LightweightSemaphore
+// BasicLightweightSemaphore
+// Spins briefly in user space before falling back to SemaphoreType, which must provide
+// wait() and signal(int count), timedWait(uint64_t usecs) if timedWait is used here,
+// and tryWait() and fd() for the pollable waits.
+// SpinPolicy, StatsPolicy, AlignmentPolicy and WakePolicy are described in policies.h.
+// Use the LightweightSemaphore alias, which uses the platform Semaphore above.
 //---------------------------------------------------------
-class LightweightSemaphore
+template <class SemaphoreType, class SpinPolicy = DefaultSpin, class StatsPolicy = NoStats, class AlignmentPolicy = NoAlignment,
+          class WakePolicy = DirectWake>
+class BasicLightweightSemaphore : private SpinPolicy, private StatsPolicy, private AlignmentPolicy, private WakePolicy
 {
 private:
     std::atomic<int> m_count;
-    Semaphore m_sema;
+    SemaphoreType m_sema;
 
-    void waitWithPartialSpinning()
+    // Returns true if a unit was acquired. Otherwise, m_count now counts us as a waiter,
+    // and the caller must wait on m_sema.
+    bool spinThenDecrement()
     {
         int oldCount;
-        // Is there a better way to set the initial spin count?
-        // If we lower it to 1000, testBenaphore becomes 15x slower on my Core i7-5930K Windows PC,
-        // as threads start hitting the kernel semaphore.
-        int spin = 10000;
+        int spin = SpinPolicy::spinCount();
         while (spin--)
         {
             oldCount = m_count.load(std::memory_order_relaxed);
             if ((oldCount > 0) && m_count.compare_exchange_strong(oldCount, oldCount - 1, std::memory_order_acquire))
-                return;
+            {
+                SpinPolicy::onSpinResult(true);
+                StatsPolicy::onSpinSuccess();
+                return true;
+            }
             std::atomic_signal_fence(std::memory_order_acquire);     // Prevent the compiler from collapsing the loop.
         }
         oldCount = m_count.fetch_sub(1, std::memory_order_acquire);
-        if (oldCount <= 0)
+        // A unit may have turned up just now, but the spin didn't pay off.
+        SpinPolicy::onSpinResult(false);
+        if (oldCount > 0)
         {
-            m_sema.wait();
+            // Still got in without sleeping, so it counts as a spin success.
+            StatsPolicy::onSpinSuccess();
+            return true;
         }
+        StatsPolicy::onKernelWait();
+        return false;
+    }
+
+    // Marks the thread as parked, so that owner-aware spinners (see OwnerAwareSpin) stop
+    // spinning on any lock that it holds.
+    void kernelWait()
+    {
+        ThreadRunState::ParkScope park;
+        m_sema.wait();
+    }
+
+    bool kernelTimedWait(uint64_t usecs)
+    {
+        ThreadRunState::ParkScope park;
+        return m_sema.timedWait(usecs);
+    }
+
+    void waitWithPartialSpinning()
+    {
+        if (!spinThenDecrement())
+        {
+            kernelWait();
+            WakePolicy::onWoken(m_sema);
+        }
+    }
+
+    // Called by a thread that gave up waiting while m_count still counts it as a waiter.
+    // Undoes the decrement, unless a concurrent signal() already counted us. In that case,
+    // it owes us a kernel signal, so take it and return true.
+    bool cancelWait()
+    {
+        int oldCount = m_count.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (oldCount >= 0)
+            {
+                kernelWait();
+                WakePolicy::onWoken(m_sema);
+                return true;
+            }
+            if (m_count.compare_exchange_weak(oldCount, oldCount + 1, std::memory_order_relaxed))
+                return false;
+        }
+    }
+
+    bool timedWaitWithPartialSpinning(uint64_t usecs)
+    {
+        if (spinThenDecrement())
+            return true;
+        if (kernelTimedWait(usecs))
+        {
+            WakePolicy::onWoken(m_sema);
+            return true;
+        }
+        return cancelWait();
     }
 
 public:
-    LightweightSemaphore(int initialCount = 0) : m_count(initialCount)
+    BasicLightweightSemaphore(int initialCount = 0) : m_count(initialCount)
     {
         assert(initialCount >= 0);
     }
@@ -203,23 +525,79 @@ public:
 
     void wait()
     {
-        if (!tryWait())
+        if (tryWait())
+            StatsPolicy::onUncontended();
+        else
             waitWithPartialSpinning();
     }
 
+    // Returns false if the timeout expired first.
+    bool timedWait(uint64_t usecs)
+    {
+        if (tryWait())
+        {
+            StatsPolicy::onUncontended();
+            return true;
+        }
+        return timedWaitWithPartialSpinning(usecs);
+    }
+
+    // Waiting from an event loop, when SemaphoreType has a pollable fd(), such as EventfdSemaphore:
+    // If beginPollableWait() returns false, we're registered as a waiter. Wait for fd() to
+    // become readable, then call finishPollableWait(), and keep polling if it returns false.
+    // To stop waiting, call cancelPollableWait(), which returns true if a unit was taken anyway.
+    bool beginPollableWait()
+    {
+        return tryWait() || m_count.fetch_sub(1, std::memory_order_acquire) > 0;
+    }
+
+    bool finishPollableWait()
+    {
+        if (!m_sema.tryWait())
+            return false;
+        WakePolicy::onWoken(m_sema);
+        return true;
+    }
+
+    bool cancelPollableWait()
+    {
+        return cancelWait();
+    }
+
+    int fd() const
+    {
+        return m_sema.fd();
+    }
+
+    SemaphoreType& kernelSemaphore()
+    {
+        return m_sema;
+    }
+
+    const StatsPolicy& stats() const
+    {
+        return *this;
+    }
+
     void signal(int count = 1)
     {
         int oldCount = m_count.fetch_add(count, std::memory_order_release);
         int toRelease = -oldCount < count ? -oldCount : count;
         if (toRelease > 0)
         {
-            m_sema.signal(toRelease);
+            WakePolicy::wake(m_sema, toRelease);
         }
     }
 };
 
 
+typedef BasicLightweightSemaphore<Semaphore> LightweightSemaphore;
 typedef LightweightSemaphore DefaultSemaphoreType;
 
+#if defined(__linux__)
+typedef BasicLightweightSemaphore<EventfdSemaphore> PollableSemaphore;
+typedef BasicLightweightSemaphore<FutexSemaphore> FutexLightweightSemaphore;
+#endif
+
 
 #endif // __CPP11OM_SEMAPHORE_H__
@@ -0,0 +1,256 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <cassert>
+#include <cstdio>
+#include <new>
+#include "shardedinmemorylogger.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// From <linux/mempolicy.h>, which isn't always installed.
+#define CPP11OM_MPOL_PREFERRED 1
+#endif
+
+
+CPP11OM_THREAD_LOCAL ShardedInMemoryLogger::ThreadCache ShardedInMemoryLogger::s_threadCache;
+std::atomic<uint64_t> ShardedInMemoryLogger::s_nextLoggerId(1);   // 0 means "no logger" in s_threadCache.
+CPP11OM_THREAD_LOCAL int ShardedInMemoryLogger::s_threadIndexPlusOne;
+ThreadSlotBitmap<ShardedInMemoryLogger::MAX_THREADS> ShardedInMemoryLogger::s_usedSlots;
+
+int ShardedInMemoryLogger::claimIndex()
+{
+    int index = s_usedSlots.claim();
+    if (index >= 0)
+        ThreadExitHook::add(releaseIndex, index);
+    return index;
+}
+
+void ShardedInMemoryLogger::releaseIndex(int index)
+{
+    // Anything logged after this point, such as from another TLS destructor, uses s_threadCache.
+    s_threadIndexPlusOne = -1;
+    s_usedSlots.release(index);
+}
+
+int ShardedInMemoryLogger::nodeCount()
+{
+    int count = 1;
+#if defined(_WIN32)
+    ULONG highest;
+    if (GetNumaHighestNodeNumber(&highest))
+        count = (int) highest + 1;
+#elif defined(__linux__)
+    // Contains a list of ranges, such as "0" or "0-1". The highest node number comes last.
+    if (FILE* f = std::fopen("/sys/devices/system/node/possible", "r"))
+    {
+        int c;
+        int number = 0;
+        while ((c = std::fgetc(f)) != EOF)
+        {
+            if (c >= '0' && c <= '9')
+                number = number * 10 + (c - '0');
+            else if (c == '-' || c == ',')
+                number = 0;
+        }
+        std::fclose(f);
+        count = number + 1;
+    }
+#endif
+    if (count > MAX_NODES)
+        count = MAX_NODES;
+    return count;
+}
+
+int ShardedInMemoryLogger::currentNode()
+{
+    int node = 0;
+#if defined(_WIN32)
+    PROCESSOR_NUMBER processor;
+    USHORT nodeNumber;
+    GetCurrentProcessorNumberEx(&processor);
+    if (GetNumaProcessorNodeEx(&processor, &nodeNumber))
+        node = nodeNumber;
+#elif defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu, nodeNumber;
+    if (syscall(SYS_getcpu, &cpu, &nodeNumber, nullptr) == 0)
+        node = (int) nodeNumber;
+#endif
+    return node;
+}
+
+ShardedInMemoryLogger::Page* ShardedInMemoryLogger::allocatePage(int node)
+{
+    void* mem;
+#if defined(_WIN32)
+    mem = VirtualAllocExNuma(GetCurrentProcess(), nullptr, sizeof(Page), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, (DWORD) node);
+    if (!mem)
+        throw std::bad_alloc();
+#elif defined(__linux__)
+    mem = mmap(nullptr, sizeof(Page), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        throw std::bad_alloc();
+#if defined(SYS_mbind)
+    // Nothing has been touched yet, so no physical memory has been assigned. Ask for it on
+    // the shard's node. If mbind() fails, for example because the kernel was built without
+    // NUMA support, first touch by the constructor below still places it on the current node.
+    const int bitsPerWord = 8 * sizeof(unsigned long);
+    unsigned long nodeMask[MAX_NODES / bitsPerWord] = {};
+    nodeMask[node / bitsPerWord] = 1ul << (node % bitsPerWord);
+    // maxnode counts one more bit than the mask holds. It's a long-standing kernel quirk.
+    syscall(SYS_mbind, mem, sizeof(Page), CPP11OM_MPOL_PREFERRED, nodeMask, (unsigned long) MAX_NODES + 1, 0);
+#endif
+#else
+    mem = ::operator new(sizeof(Page));
+#endif
+    return new (mem) Page;
+}
+
+void ShardedInMemoryLogger::freePage(Page* page)
+{
+    page->~Page();
+#if defined(_WIN32)
+    VirtualFree(page, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(page, sizeof(Page));
+#else
+    ::operator delete(page);
+#endif
+}
+
+ShardedInMemoryLogger::ShardedInMemoryLogger(int shardsPerNode)
+    : m_loggerId(s_nextLoggerId.fetch_add(1, std::memory_order_relaxed))
+    , m_shardsPerNode(shardsPerNode)
+    , m_shardCount(nodeCount() * shardsPerNode)
+    , m_shards(new Shard[m_shardCount])
+    , m_threadShards(new Shard*[MAX_THREADS]())
+    , m_nextThreadIndex(0)
+{
+    assert(shardsPerNode > 0);
+    for (int i = 0; i < m_shardCount; i++)
+    {
+        Shard& shard = m_shards[i];
+        shard.node = i / shardsPerNode;
+        shard.head = allocatePage(shard.node);
+        shard.tail.store(shard.head, std::memory_order_relaxed);
+    }
+}
+
+ShardedInMemoryLogger::~ShardedInMemoryLogger()
+{
+    for (int i = 0; i < m_shardCount; i++)
+    {
+        Page* page = m_shards[i].head;
+        while (page)
+        {
+            Page* next = page->next;
+            freePage(page);
+            page = next;
+        }
+    }
+}
+
+ShardedInMemoryLogger::Shard* ShardedInMemoryLogger::getShardSlow(int threadIndex)
+{
+    int nodeIndex = currentNode() % (m_shardCount / m_shardsPerNode);
+    int spread = m_nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+    Shard* shard = &m_shards[nodeIndex * m_shardsPerNode + spread % m_shardsPerNode];
+    if (threadIndex >= 0)
+    {
+        m_threadShards[threadIndex] = shard;
+    }
+    else
+    {
+        s_threadCache.loggerId = m_loggerId;
+        s_threadCache.shard = shard;
+    }
+    return shard;
+}
+
+ShardedInMemoryLogger::Event* ShardedInMemoryLogger::allocateEventFromNewPage(Shard* shard)
+{
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    // Double-checked locking, exactly as in InMemoryLogger::allocateEventFromNewPage.
+    Page* oldTail = shard->tail.load(std::memory_order_relaxed);
+    if (oldTail->index.load(std::memory_order_relaxed) < EVENTS_PER_PAGE)
+    {
+        int index = oldTail->index.fetch_add(1, std::memory_order_relaxed);
+        if (index < EVENTS_PER_PAGE)
+            return &oldTail->events[index];
+    }
+
+    // The calling thread may have migrated to another node since it chose this shard,
+    // so the page is bound to the shard's node rather than the current one.
+    Page* page = allocatePage(shard->node);
+    page->index.store(1, std::memory_order_relaxed);
+    oldTail->next = page;
+    // Release/consume, so that the page's constructed contents are visible to other threads.
+    shard->tail.store(page, std::memory_order_release);
+    return &page->events[0];
+}
+
+size_t ShardedInMemoryLogger::eventCount() const
+{
+    size_t count = 0;
+    for (int i = 0; i < m_shardCount; i++)
+    {
+        for (const Page* page = m_shards[i].head; page; page = page->next)
+        {
+            int size = page->index.load(std::memory_order_relaxed);
+            count += size < EVENTS_PER_PAGE ? size : EVENTS_PER_PAGE;
+        }
+    }
+    return count;
+}
+
+ShardedInMemoryLogger::Iterator::Iterator(const ShardedInMemoryLogger* logger)
+    : m_current(-1)
+{
+    for (int i = 0; i < logger->m_shardCount; i++)
+    {
+        Cursor cursor;
+        cursor.page = logger->m_shards[i].head;
+        cursor.index = -1;
+        if (advance(cursor))
+            m_cursors.push_back(cursor);
+    }
+    selectNext();
+}
+
+// Moves the cursor to the next event in its shard. Returns false when the shard is exhausted.
+bool ShardedInMemoryLogger::Iterator::advance(Cursor& cursor)
+{
+    cursor.index++;
+    while (cursor.index >= pageSize(cursor.page))
+    {
+        const Page* next = cursor.page->next;
+        if (!next)
+            return false;
+        cursor.page = next;
+        cursor.index = 0;
+    }
+    return true;
+}
+
+void ShardedInMemoryLogger::Iterator::selectNext()
+{
+    // Linear scan is fine: there are only a few shards per node.
+    m_current = -1;
+    uint64_t earliest = 0;
+    for (int i = 0; i < (int) m_cursors.size(); i++)
+    {
+        uint64_t timestamp = m_cursors[i].page->events[m_cursors[i].index].timestamp;
+        if (m_current < 0 || timestamp < earliest)
+        {
+            m_current = i;
+            earliest = timestamp;
+        }
+    }
+}
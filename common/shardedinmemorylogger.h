@@ -0,0 +1,259 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_SHARDED_IN_MEMORY_LOGGER_H__
+#define __CPP11OM_SHARDED_IN_MEMORY_LOGGER_H__
+
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "threadlocal.h"
+#include "threadslots.h"
+
+
+//---------------------------------------------------------
+// ShardedInMemoryLogger
+// Same purpose as InMemoryLogger, but keeps a separate chain of pages for each NUMA node,
+// so that on multi-socket machines, log() never writes to a page on another socket.
+// - Each thread picks a shard the first time it logs to a given logger, based on the node
+//   it's running on, and keeps using it, even if it alternates between several loggers.
+//   The choice is stored per logger, indexed by a process-wide thread slot. Beyond
+//   MAX_THREADS concurrent threads, a thread remembers only the last logger it used, and
+//   chooses again when it switches.
+// - Pages are bound to their shard's node before they are touched, using mbind() on Linux
+//   and VirtualAllocExNuma() on Windows. Elsewhere, there's a single node, and first touch
+//   by the allocating thread does the rest.
+// - With shardsPerNode > 1, threads on the same node are spread round-robin over several
+//   chains, which can stand in for L3 domains on CPUs that have several per node.
+// Like InMemoryLogger, log() is lock-free, except when it's time to allocate a new Page.
+//
+// Each event is timestamped, and Iterator merges the shards back into a single timeline.
+// A thread always logs to the same shard, so its own events come out in the order it logged
+// them. Within a shard, events come out in the order their slots were reserved, so an event
+// whose thread was preempted between reserving its slot and reading the clock can come out
+// slightly late relative to other shards.
+// Iterator should only be used after logging is complete.
+//---------------------------------------------------------
+class ShardedInMemoryLogger
+{
+public:
+    struct Event
+    {
+        std::thread::id tid;
+        const char* msg;
+        size_t param;
+        uint64_t timestamp;     // Nanoseconds on std::chrono::steady_clock.
+
+        Event() : msg(nullptr), param(0), timestamp(0) {}
+    };
+
+private:
+    static const int EVENTS_PER_PAGE = 16384;
+    static const int MAX_NODES = 64;
+    static const int MAX_THREADS = 256;
+    static const int CACHE_LINE_SIZE = 64;
+
+    // Lives in memory bound to a single node. See allocatePage().
+    struct Page
+    {
+        Page* next;
+        std::atomic<int> index;     // This can exceed EVENTS_PER_PAGE, but it's harmless. Just means page is full.
+        Event events[EVENTS_PER_PAGE];
+
+        Page() : next(nullptr), index(0) {}
+    };
+
+    // Padded so that allocating a page in one shard doesn't disturb log() in the others.
+    struct Shard
+    {
+        std::mutex mutex;           // Only locked when it's time to allocate a new page.
+        Page* head;
+        std::atomic<Page*> tail;
+        int node;
+        char padding[CACHE_LINE_SIZE];
+
+        Shard() : head(nullptr), tail(nullptr), node(0) {}
+    };
+
+    // For threads without a slot: remembers the shard chosen for the last logger used.
+    // Logger IDs are never reused, so a stale entry can't be mistaken for a new logger at
+    // the same address.
+    struct ThreadCache
+    {
+        uint64_t loggerId;
+        Shard* shard;
+    };
+    static CPP11OM_THREAD_LOCAL ThreadCache s_threadCache;
+    static std::atomic<uint64_t> s_nextLoggerId;
+
+    // Same scheme as ThreadRunState. Slots go back to the table when threads exit.
+    static CPP11OM_THREAD_LOCAL int s_threadIndexPlusOne;    // 0 until the thread asks; -1 if it got no slot
+    static ThreadSlotBitmap<MAX_THREADS> s_usedSlots;
+
+    uint64_t m_loggerId;
+    int m_shardsPerNode;
+    int m_shardCount;
+    std::unique_ptr<Shard[]> m_shards;
+    // The shard chosen by the thread in each slot, or null. Only read and written by that
+    // thread. When a slot changes hands, the new thread inherits the old thread's choice,
+    // which is still a valid shard, just possibly on another node.
+    std::unique_ptr<Shard*[]> m_threadShards;
+    std::atomic<int> m_nextThreadIndex;     // Spreads threads over the shards of a node.
+
+    ShardedInMemoryLogger(const ShardedInMemoryLogger& other) = delete;
+    ShardedInMemoryLogger& operator=(const ShardedInMemoryLogger& other) = delete;
+
+    static int claimIndex();
+    static void releaseIndex(int index);
+
+    // Returns -1 if the calling thread has no slot.
+    static int threadIndex()
+    {
+        int plusOne = s_threadIndexPlusOne;
+        if (plusOne == 0)
+        {
+            int index = claimIndex();
+            plusOne = index >= 0 ? index + 1 : -1;
+            s_threadIndexPlusOne = plusOne;
+        }
+        return plusOne > 0 ? plusOne - 1 : -1;
+    }
+
+    Shard* getShardSlow(int threadIndex);
+    Event* allocateEventFromNewPage(Shard* shard);
+
+    // The calling thread's shard, chosen the first time it logs to this logger.
+    Shard* currentShard()
+    {
+        Shard* shard;
+        int index = threadIndex();
+        if (index >= 0)
+            shard = m_threadShards[index];
+        else
+            shard = s_threadCache.loggerId == m_loggerId ? s_threadCache.shard : nullptr;
+        if (!shard)
+            shard = getShardSlow(index);
+        return shard;
+    }
+    static Page* allocatePage(int node);
+    static void freePage(Page* page);
+
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    // Number of NUMA nodes on this machine, and the node the calling thread is running on.
+    // Without NUMA support, there's one node, numbered 0.
+    static int nodeCount();
+    static int currentNode();
+
+    ShardedInMemoryLogger(int shardsPerNode = 1);
+    ~ShardedInMemoryLogger();
+
+    void log(const char* msg, size_t param = 0)
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);    // Compiler barrier
+        Shard* shard = currentShard();
+        // See InMemoryLogger::log for a discussion of memory_order_consume.
+        Page* page = shard->tail.load(std::memory_order_consume);
+        Event* evt;
+        int index = page->index.fetch_add(1, std::memory_order_relaxed);
+        if (index < EVENTS_PER_PAGE)
+            evt = &page->events[index];
+        else
+            evt = allocateEventFromNewPage(shard);   // Double-checked locking is performed inside here.
+        evt->tid = std::this_thread::get_id();
+        evt->msg = msg;
+        evt->param = param;
+        evt->timestamp = now();
+        std::atomic_signal_fence(std::memory_order_seq_cst);    // Compiler barrier
+    }
+
+    int shardCount() const
+    {
+        return m_shardCount;
+    }
+
+    // Index of the shard that the calling thread logs to, in [0, shardCount()).
+    int currentShardIndex()
+    {
+        return (int) (currentShard() - m_shards.get());
+    }
+
+    // Like Iterator, this should only be used after logging is complete.
+    size_t eventCount() const;
+
+    // Iterators are meant to be used only after all logging is complete.
+    // Walks each shard's chain of pages and returns the events merged by timestamp.
+    friend class Iterator;
+    class Iterator
+    {
+    private:
+        struct Cursor
+        {
+            const Page* page;
+            int index;
+        };
+
+        std::vector<Cursor> m_cursors;     // Only shards with events left.
+        int m_current;      // Index of the cursor holding the current event, or -1 at the end.
+
+        static int pageSize(const Page* page)
+        {
+            int size = page->index.load(std::memory_order_relaxed);
+            return size < EVENTS_PER_PAGE ? size : EVENTS_PER_PAGE;
+        }
+
+        static bool advance(Cursor& cursor);
+        void selectNext();
+
+    public:
+        Iterator() : m_current(-1) {}
+        Iterator(const ShardedInMemoryLogger* logger);
+
+        Iterator& operator++()
+        {
+            if (!advance(m_cursors[m_current]))
+                m_cursors.erase(m_cursors.begin() + m_current);
+            selectNext();
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            if (m_current < 0 || other.m_current < 0)
+                return m_current != other.m_current;
+            const Cursor& a = m_cursors[m_current];
+            const Cursor& b = other.m_cursors[other.m_current];
+            return (a.page != b.page) || (a.index != b.index);
+        }
+
+        const Event& operator*() const
+        {
+            const Cursor& cursor = m_cursors[m_current];
+            return cursor.page->events[cursor.index];
+        }
+    };
+
+    Iterator begin() const
+    {
+        return Iterator(this);
+    }
+
+    Iterator end() const
+    {
+        return Iterator();
+    }
+};
+
+
+#endif // __CPP11OM_SHARDED_IN_MEMORY_LOGGER_H__
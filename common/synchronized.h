@@ -0,0 +1,196 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_SYNCHRONIZED_H__
+#define __CPP11OM_SYNCHRONIZED_H__
+
+#include <cassert>
+#include <utility>
+#include <type_traits>
+#include "benaphore.h"
+#include "rwlock.h"
+
+
+//---------------------------------------------------------
+// IsOnlyArgOfType
+// True when Args is a single argument whose decayed type is Wrapper. Used to keep the
+// forwarding constructors below from being picked over the (deleted) copy constructor.
+//---------------------------------------------------------
+template <class Wrapper, class... Args>
+struct IsOnlyArgOfType : std::false_type
+{
+};
+
+template <class Wrapper, class Arg>
+struct IsOnlyArgOfType<Wrapper, Arg> : std::is_same<typename std::decay<Arg>::type, Wrapper>
+{
+};
+
+
+//---------------------------------------------------------
+// Synchronized
+// Stores a T right next to the lock that protects it, so the critical section usually
+// finds the data in the same or the adjacent cache line as the lock word, and makes the
+// data reachable only through a Guard, so it can't be touched without holding the lock.
+//
+//     Synchronized<std::vector<int>> list;
+//     list.lock()->push_back(1);           // Locked for the duration of the expression
+//     {
+//         Synchronized<std::vector<int>>::Guard guard = list.lock();
+//         ...                              // Locked until guard goes out of scope
+//     }
+//---------------------------------------------------------
+template <class T, class LockType = NonRecursiveBenaphore>
+class Synchronized
+{
+private:
+    LockType m_lock;
+    T m_data;
+
+    Synchronized(const Synchronized& other) = delete;
+    Synchronized& operator=(const Synchronized& other) = delete;
+
+public:
+    class Guard
+    {
+    private:
+        Synchronized* m_owner;
+
+        Guard(const Guard& other) = delete;
+        Guard& operator=(const Guard& other) = delete;
+
+        // Takes ownership of a lock that has already been acquired (or nullptr).
+        friend class Synchronized;
+        explicit Guard(Synchronized* owner) : m_owner(owner) {}
+
+    public:
+        Guard(Guard&& other) : m_owner(other.m_owner)
+        {
+            other.m_owner = nullptr;
+        }
+
+        ~Guard()
+        {
+            if (m_owner)
+                m_owner->m_lock.unlock();
+        }
+
+        // False if returned by a failed tryLock().
+        explicit operator bool() const { return m_owner != nullptr; }
+
+        T* operator->() const { assert(m_owner); return &m_owner->m_data; }
+        T& operator*() const { assert(m_owner); return m_owner->m_data; }
+    };
+
+    template <typename... Args,
+              typename = typename std::enable_if<!IsOnlyArgOfType<Synchronized, Args...>::value>::type>
+    explicit Synchronized(Args&&... args) : m_data(std::forward<Args>(args)...) {}
+
+    Guard lock()
+    {
+        m_lock.lock();
+        return Guard(this);
+    }
+
+    Guard tryLock()
+    {
+        return Guard(m_lock.tryLock() ? this : nullptr);
+    }
+};
+
+
+//---------------------------------------------------------
+// RWSynchronized
+// Like Synchronized, but protected by a reader-writer lock.
+// ReadGuard only grants const access.
+//---------------------------------------------------------
+template <class T, class RWLockType = NonRecursiveRWLock>
+class RWSynchronized
+{
+private:
+    RWLockType m_rwLock;
+    T m_data;
+
+    RWSynchronized(const RWSynchronized& other) = delete;
+    RWSynchronized& operator=(const RWSynchronized& other) = delete;
+
+public:
+    class ReadGuard
+    {
+    private:
+        RWSynchronized* m_owner;
+
+        ReadGuard(const ReadGuard& other) = delete;
+        ReadGuard& operator=(const ReadGuard& other) = delete;
+
+        friend class RWSynchronized;
+        explicit ReadGuard(RWSynchronized* owner) : m_owner(owner)
+        {
+            m_owner->m_rwLock.lockReader();
+        }
+
+    public:
+        ReadGuard(ReadGuard&& other) : m_owner(other.m_owner)
+        {
+            other.m_owner = nullptr;
+        }
+
+        ~ReadGuard()
+        {
+            if (m_owner)
+                m_owner->m_rwLock.unlockReader();
+        }
+
+        const T* operator->() const { return &m_owner->m_data; }
+        const T& operator*() const { return m_owner->m_data; }
+    };
+
+    class WriteGuard
+    {
+    private:
+        RWSynchronized* m_owner;
+
+        WriteGuard(const WriteGuard& other) = delete;
+        WriteGuard& operator=(const WriteGuard& other) = delete;
+
+        friend class RWSynchronized;
+        explicit WriteGuard(RWSynchronized* owner) : m_owner(owner)
+        {
+            m_owner->m_rwLock.lockWriter();
+        }
+
+    public:
+        WriteGuard(WriteGuard&& other) : m_owner(other.m_owner)
+        {
+            other.m_owner = nullptr;
+        }
+
+        ~WriteGuard()
+        {
+            if (m_owner)
+                m_owner->m_rwLock.unlockWriter();
+        }
+
+        T* operator->() const { return &m_owner->m_data; }
+        T& operator*() const { return m_owner->m_data; }
+    };
+
+    template <typename... Args,
+              typename = typename std::enable_if<!IsOnlyArgOfType<RWSynchronized, Args...>::value>::type>
+    explicit RWSynchronized(Args&&... args) : m_data(std::forward<Args>(args)...) {}
+
+    ReadGuard read()
+    {
+        return ReadGuard(this);
+    }
+
+    WriteGuard write()
+    {
+        return WriteGuard(this);
+    }
+};
+
+
+#endif // __CPP11OM_SYNCHRONIZED_H__
@@ -0,0 +1,24 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_THREAD_LOCAL_H__
+#define __CPP11OM_THREAD_LOCAL_H__
+
+
+//---------------------------------------------------------
+// CPP11OM_THREAD_LOCAL
+// Storage class for plain-old-data thread-local variables.
+// Visual Studio 2013 and Apple LLVM 6.0 don't implement the C++11 thread_local keyword,
+// but every compiler we support has an equivalent extension for POD types.
+// As a bonus, the extensions never emit a lazy-initialization guard on access.
+//---------------------------------------------------------
+#if defined(_MSC_VER)
+#define CPP11OM_THREAD_LOCAL __declspec(thread)
+#else
+#define CPP11OM_THREAD_LOCAL __thread
+#endif
+
+
+#endif // __CPP11OM_THREAD_LOCAL_H__
@@ -0,0 +1,46 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <thread>
+#include "threadrunstate.h"
+
+
+CPP11OM_THREAD_LOCAL int ThreadRunState::s_threadIndexPlusOne;
+ThreadSlotBitmap<ThreadRunState::MAX_THREADS> ThreadRunState::s_usedSlots;
+ThreadRunState::Slot ThreadRunState::s_slots[MAX_THREADS];
+std::atomic<int> ThreadRunState::s_coreCount(0);
+std::atomic<bool> ThreadRunState::s_enabled(false);
+
+int ThreadRunState::claimIndex()
+{
+    int index = s_usedSlots.claim();
+    // If the hook isn't available, the slot is never returned, as if the thread never exited.
+    if (index >= 0)
+        ThreadExitHook::add(releaseIndex, index);
+    return index;
+}
+
+void ThreadRunState::releaseIndex(int index)
+{
+    // Anything that runs in this thread after this point, such as another TLS destructor,
+    // gets no slot rather than claiming a new one that would never be released.
+    s_threadIndexPlusOne = -1;
+    s_slots[index].parked.store(0, std::memory_order_relaxed);
+    s_usedSlots.release(index);
+}
+
+bool ThreadRunState::isMultiCore()
+{
+    // hardware_concurrency() can be slow, so cache it. Racing threads store the same value.
+    int coreCount = s_coreCount.load(std::memory_order_relaxed);
+    if (coreCount == 0)
+    {
+        coreCount = (int) std::thread::hardware_concurrency();
+        if (coreCount == 0)
+            coreCount = 2;      // Unknown. Assume spinning might help.
+        s_coreCount.store(coreCount, std::memory_order_relaxed);
+    }
+    return coreCount > 1;
+}
@@ -0,0 +1,105 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_THREAD_RUN_STATE_H__
+#define __CPP11OM_THREAD_RUN_STATE_H__
+
+#include <atomic>
+#include <cstdint>
+#include "threadlocal.h"
+#include "threadslots.h"
+
+
+//---------------------------------------------------------
+// ThreadRunState
+// A process-wide table of per-thread "parked" flags, so that a thread spinning on a lock can
+// tell whether the lock's owner is asleep, in which case spinning is pointless. A thread is
+// parked while it waits on a kernel semaphore inside BasicLightweightSemaphore. Other blocking
+// calls, and preemption, aren't visible here; it's a cheap hint, not a scheduler query.
+// Nothing is tracked until the first OwnerAwareSpin is constructed and calls enable(), so
+// programs that never spin on an owner pay nothing, and use no slots, when they wait.
+// Up to MAX_THREADS threads at a time hold a slot, which goes back to the table when the
+// thread exits. Threads beyond that get NO_INDEX, and always look like they're running.
+//---------------------------------------------------------
+class ThreadRunState
+{
+public:
+    static const int MAX_THREADS = 256;
+    static const int NO_INDEX = -1;
+
+private:
+    static const int CACHE_LINE_SIZE = 64;
+
+    struct Slot
+    {
+        std::atomic<int> parked;
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<int>)];
+    };
+
+    static CPP11OM_THREAD_LOCAL int s_threadIndexPlusOne;    // 0 until the thread asks; -1 if it got no slot
+    static ThreadSlotBitmap<MAX_THREADS> s_usedSlots;
+    static Slot s_slots[MAX_THREADS];
+    static std::atomic<int> s_coreCount;
+    static std::atomic<bool> s_enabled;
+
+    // Takes a free slot and arranges for releaseIndex() to be called when the thread exits.
+    static int claimIndex();
+    static void releaseIndex(int index);
+
+public:
+    static void enable()
+    {
+        s_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    static int currentIndex()
+    {
+        int plusOne = s_threadIndexPlusOne;
+        if (plusOne == 0)
+        {
+            int index = claimIndex();
+            plusOne = index >= 0 ? index + 1 : -1;
+            s_threadIndexPlusOne = plusOne;
+        }
+        return plusOne > 0 ? plusOne - 1 : NO_INDEX;
+    }
+
+    static bool isRunning(int index)
+    {
+        return index < 0 || s_slots[index].parked.load(std::memory_order_relaxed) == 0;
+    }
+
+    // True when there's another core for a spinning thread's owner to run on.
+    static bool isMultiCore();
+
+    //---------------------------------------------------------
+    // ParkScope
+    // Marks the current thread as parked for the lifetime of the object.
+    //---------------------------------------------------------
+    class ParkScope
+    {
+    private:
+        int m_index;
+
+        ParkScope(const ParkScope& other) = delete;
+        ParkScope& operator=(const ParkScope& other) = delete;
+
+    public:
+        ParkScope() : m_index(s_enabled.load(std::memory_order_relaxed) ? currentIndex() : NO_INDEX)
+        {
+            if (m_index >= 0)
+                s_slots[m_index].parked.store(1, std::memory_order_relaxed);
+        }
+
+        ~ParkScope()
+        {
+            if (m_index >= 0)
+                s_slots[m_index].parked.store(0, std::memory_order_relaxed);
+        }
+    };
+};
+
+
+#endif // __CPP11OM_THREAD_RUN_STATE_H__
@@ -0,0 +1,99 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "threadslots.h"
+#include "threadlocal.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+
+// The calling thread's callbacks. The TLS key's value points here, since destructors are
+// only called for non-null values.
+struct ThreadExitCallbacks
+{
+    ThreadExitHook::Func funcs[ThreadExitHook::MAX_CALLBACKS];
+    int args[ThreadExitHook::MAX_CALLBACKS];
+    int count;
+};
+
+static CPP11OM_THREAD_LOCAL ThreadExitCallbacks g_threadExitCallbacks;
+
+static void runThreadExitCallbacks(ThreadExitCallbacks* callbacks)
+{
+    while (callbacks->count > 0)
+    {
+        int i = --callbacks->count;
+        callbacks->funcs[i](callbacks->args[i]);
+    }
+}
+
+#if defined(_WIN32)
+
+static INIT_ONCE g_exitHookOnce = INIT_ONCE_STATIC_INIT;
+static DWORD g_exitHookKey = FLS_OUT_OF_INDEXES;
+
+static VOID WINAPI onThreadExit(PVOID value)
+{
+    runThreadExitCallbacks((ThreadExitCallbacks*) value);
+}
+
+static BOOL CALLBACK createExitHook(PINIT_ONCE, PVOID, PVOID*)
+{
+    g_exitHookKey = FlsAlloc(onThreadExit);
+    return TRUE;
+}
+
+static bool armExitHook()
+{
+    InitOnceExecuteOnce(&g_exitHookOnce, createExitHook, nullptr, nullptr);
+    return g_exitHookKey != FLS_OUT_OF_INDEXES && FlsSetValue(g_exitHookKey, &g_threadExitCallbacks);
+}
+
+#else
+
+static pthread_once_t g_exitHookOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t g_exitHookKey;
+static bool g_exitHookCreated = false;
+
+static void onThreadExit(void* value)
+{
+    runThreadExitCallbacks((ThreadExitCallbacks*) value);
+}
+
+static void createExitHook()
+{
+    g_exitHookCreated = (pthread_key_create(&g_exitHookKey, onThreadExit) == 0);
+}
+
+static bool armExitHook()
+{
+    pthread_once(&g_exitHookOnce, createExitHook);
+    return g_exitHookCreated && pthread_setspecific(g_exitHookKey, &g_threadExitCallbacks) == 0;
+}
+
+#endif
+
+
+//---------------------------------------------------------
+// ThreadExitHook
+//---------------------------------------------------------
+bool ThreadExitHook::add(Func func, int arg)
+{
+    ThreadExitCallbacks& callbacks = g_threadExitCallbacks;
+    if (callbacks.count >= MAX_CALLBACKS)
+        return false;
+    // Arm the hook with the first callback. It's disarmed again after it runs.
+    if (callbacks.count == 0 && !armExitHook())
+        return false;
+    callbacks.funcs[callbacks.count] = func;
+    callbacks.args[callbacks.count] = arg;
+    callbacks.count++;
+    return true;
+}
@@ -0,0 +1,74 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_THREAD_SLOTS_H__
+#define __CPP11OM_THREAD_SLOTS_H__
+
+#include <atomic>
+#include <cstdint>
+
+
+//---------------------------------------------------------
+// ThreadExitHook
+// Calls func(arg) on the calling thread when it exits, without the C++11 thread_local
+// keyword (see threadlocal.h): a pthread key destructor on POSIX, an FLS callback on Windows.
+// Callbacks run in reverse order of registration. Each thread can register up to
+// MAX_CALLBACKS; add() returns false once they're used up, or if the hook isn't available.
+// The main thread's callbacks may not run, since the process is exiting anyway.
+//---------------------------------------------------------
+class ThreadExitHook
+{
+public:
+    typedef void (*Func)(int arg);
+    static const int MAX_CALLBACKS = 8;
+
+    static bool add(Func func, int arg);
+};
+
+
+//---------------------------------------------------------
+// ThreadSlotBitmap
+// Tracks which of the N slots in a fixed table of per-thread state are taken, so that a
+// slot can go back to the table when its thread exits, typically from a ThreadExitHook.
+// claim() takes the lowest free slot, or returns -1 if there are none. A static instance
+// needs no constructor: all zeros means every slot is free.
+//---------------------------------------------------------
+template <int N>
+class ThreadSlotBitmap
+{
+private:
+    static const int BITS_PER_WORD = 64;
+    std::atomic<uint64_t> m_words[(N + BITS_PER_WORD - 1) / BITS_PER_WORD];
+
+public:
+    int claim()
+    {
+        for (int word = 0; word * BITS_PER_WORD < N; word++)
+        {
+            uint64_t used = m_words[word].load(std::memory_order_relaxed);
+            for (;;)
+            {
+                int bit = 0;
+                while (bit < BITS_PER_WORD && (used & (uint64_t(1) << bit)))
+                    bit++;
+                if (bit == BITS_PER_WORD || word * BITS_PER_WORD + bit >= N)
+                    break;
+                // Acquire pairs with the release in release(), so the previous owner's last
+                // writes to the slot's state are visible to the new one.
+                if (m_words[word].compare_exchange_weak(used, used | (uint64_t(1) << bit), std::memory_order_acquire, std::memory_order_relaxed))
+                    return word * BITS_PER_WORD + bit;
+            }
+        }
+        return -1;
+    }
+
+    void release(int index)
+    {
+        m_words[index / BITS_PER_WORD].fetch_and(~(uint64_t(1) << (index % BITS_PER_WORD)), std::memory_order_release);
+    }
+};
+
+
+#endif // __CPP11OM_THREAD_SLOTS_H__
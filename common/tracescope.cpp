@@ -0,0 +1,67 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <cassert>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include "tracescope.h"
+
+
+CPP11OM_THREAD_LOCAL TraceScope* TraceScope::s_innermost;
+CPP11OM_THREAD_LOCAL size_t TraceScope::s_nextSpanId;
+
+std::vector<TraceScopeStats> aggregateTraceScopes(InMemoryLogger& logger)
+{
+    struct Frame
+    {
+        const char* name;
+        uint64_t childNanos;
+    };
+
+    // Each thread's scopes are properly nested, and InMemoryLogger preserves the order of
+    // events within each thread, so a stack per thread is enough to match begin with end.
+    std::map<std::thread::id, std::vector<Frame>> stacks;
+    std::unordered_map<const char*, TraceScopeStats> statsByName;
+
+    for (const auto& evt : logger)
+    {
+        TraceScope::TraceParam param = evt.param;
+        if (!param.isTrace)
+            continue;
+        const char* msg = evt.msg;
+        std::vector<Frame>& stack = stacks[evt.tid];
+        if (!param.isEnd)
+        {
+            assert(param.depth == std::min<size_t>(stack.size(), param.depth.maximum()));
+            Frame frame = { msg, 0 };
+            stack.push_back(frame);
+        }
+        else
+        {
+            assert(!stack.empty() && stack.back().name == msg);
+            uint64_t duration = param.duration;
+            uint64_t childNanos = stack.back().childNanos;
+            stack.pop_back();
+            if (!stack.empty())
+                stack.back().childNanos += duration;
+
+            auto inserted = statsByName.insert(std::make_pair(msg, TraceScopeStats(msg)));
+            TraceScopeStats& stats = inserted.first->second;
+            stats.calls++;
+            stats.inclusiveNanos += duration;
+            // Guard against rounding between separately measured parent and child durations.
+            stats.exclusiveNanos += duration > childNanos ? duration - childNanos : 0;
+        }
+    }
+
+    std::vector<TraceScopeStats> result;
+    for (const auto& pair : statsByName)
+        result.push_back(pair.second);
+    std::sort(result.begin(), result.end(), [](const TraceScopeStats& a, const TraceScopeStats& b) {
+        return a.inclusiveNanos > b.inclusiveNanos;
+    });
+    return result;
+}
@@ -0,0 +1,110 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_TRACE_SCOPE_H__
+#define __CPP11OM_TRACE_SCOPE_H__
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include "inmemorylogger.h"
+#include "bitfield.h"
+#include "threadlocal.h"
+
+
+//---------------------------------------------------------
+// TraceScope
+// Logs a begin event on construction and an end event on destruction, turning
+// InMemoryLogger into a low-overhead profiler. Use aggregateTraceScopes (below)
+// to get per-scope call counts and inclusive/exclusive times once logging is complete.
+// The scope name is used as the event msg, and the param is a TraceParam (below),
+// so trace events can be interleaved with ordinary events in the same logger, as
+// long as the ordinary events never set the top bit of their param.
+// Scopes must be properly nested within each thread, which RAII guarantees.
+// Depth is counted per logger: a scope's depth is the number of enclosing scopes on the
+// same thread that log to the same logger.
+//---------------------------------------------------------
+class TraceScope
+{
+public:
+    // Begin events carry the nesting depth and a span ID that is unique within the thread.
+    // End events carry the span's duration in nanoseconds, which saves the aggregator from
+    // needing timestamps. On 32-bit platforms, durations saturate at about one second.
+    BEGIN_BITFIELD_TYPE(TraceParam, size_t)
+        ADD_BITFIELD_MEMBER(spanId, 0, sizeof(size_t) * 8 - 10)
+        ADD_BITFIELD_MEMBER(depth, sizeof(size_t) * 8 - 10, 8)
+        ADD_BITFIELD_MEMBER(duration, 0, sizeof(size_t) * 8 - 2)
+        ADD_BITFIELD_MEMBER(isEnd, sizeof(size_t) * 8 - 2, 1)
+        ADD_BITFIELD_MEMBER(isTrace, sizeof(size_t) * 8 - 1, 1)
+    END_BITFIELD_TYPE()
+
+private:
+    static CPP11OM_THREAD_LOCAL TraceScope* s_innermost;     // On the calling thread, for any logger
+    static CPP11OM_THREAD_LOCAL size_t s_nextSpanId;
+
+    InMemoryLogger& m_logger;
+    const char* m_name;
+    TraceScope* m_enclosing;
+    int m_depth;
+    std::chrono::steady_clock::time_point m_start;
+
+    TraceScope(const TraceScope& other) = delete;
+    TraceScope& operator=(const TraceScope& other) = delete;
+
+public:
+    TraceScope(InMemoryLogger& logger, const char* name) : m_logger(logger), m_name(name), m_enclosing(s_innermost), m_depth(0)
+    {
+        // Usually, the nearest enclosing scope is on the same logger, so this stops right away.
+        for (const TraceScope* scope = m_enclosing; scope; scope = scope->m_enclosing)
+        {
+            if (&scope->m_logger == &m_logger)
+            {
+                m_depth = scope->m_depth + 1;
+                break;
+            }
+        }
+        s_innermost = this;
+        TraceParam param;
+        param.isTrace = 1;
+        param.depth = m_depth < (int) param.depth.maximum() ? m_depth : param.depth.maximum();
+        param.spanId = s_nextSpanId++ & param.spanId.maximum();
+        m_logger.log(m_name, param);
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    ~TraceScope()
+    {
+        uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+        TraceParam param;
+        param.isTrace = 1;
+        param.isEnd = 1;
+        param.duration = nanos < param.duration.maximum() ? size_t(nanos) : param.duration.maximum();
+        m_logger.log(m_name, param);
+        s_innermost = m_enclosing;
+    }
+};
+
+
+//---------------------------------------------------------
+// aggregateTraceScopes
+// Replays the TraceScope events in a logger, ignoring all other events.
+// Returns one entry per distinct scope name, sorted by decreasing inclusive time.
+// Exclusive time is inclusive time minus the inclusive time of directly nested scopes.
+// Like InMemoryLogger::Iterator, this should only be used after logging is complete.
+//---------------------------------------------------------
+struct TraceScopeStats
+{
+    const char* name;
+    size_t calls;
+    uint64_t inclusiveNanos;
+    uint64_t exclusiveNanos;
+
+    TraceScopeStats(const char* name = nullptr) : name(name), calls(0), inclusiveNanos(0), exclusiveNanos(0) {}
+};
+
+std::vector<TraceScopeStats> aggregateTraceScopes(InMemoryLogger& logger);
+
+
+#endif // __CPP11OM_TRACE_SCOPE_H__
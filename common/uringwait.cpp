@@ -0,0 +1,294 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "uringwait.h"
+
+#if CPP11OM_HAVE_IO_URING
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// From <linux/futex.h> in Linux 6.7+. These are the futex2 flags that IORING_OP_FUTEX_WAIT takes.
+enum
+{
+    CPP11OM_FUTEX2_SIZE_U32 = 0x02,
+    CPP11OM_FUTEX2_PRIVATE = 128,
+};
+
+// Not in <linux/io_uring.h> before Linux 5.4 and 5.5, respectively.
+#ifndef IORING_FEAT_SINGLE_MMAP
+#define IORING_FEAT_SINGLE_MMAP (1U << 0)
+#endif
+#define CPP11OM_IORING_OP_ASYNC_CANCEL 14
+
+// IORING_REGISTER_PROBE and its structs, from Linux 5.6. Defined here rather than taken
+// from the header, since the header declares IORING_REGISTER_PROBE in an enum.
+enum
+{
+    CPP11OM_IORING_REGISTER_PROBE = 8,
+    CPP11OM_IO_URING_OP_SUPPORTED = 1,
+};
+
+struct CPP11OM_IoUringProbeOp
+{
+    uint8_t op;
+    uint8_t resv;
+    uint16_t flags;
+    uint32_t resv2;
+};
+
+struct CPP11OM_IoUringProbe
+{
+    uint8_t lastOp;
+    uint8_t opsLen;
+    uint16_t resv;
+    uint32_t resv2[3];
+    // Followed by an array of CPP11OM_IoUringProbeOp.
+};
+
+
+//---------------------------------------------------------
+// IoUring
+//---------------------------------------------------------
+IoUring::IoUring(unsigned int entries)
+    : m_fd(-1)
+    , m_sqRing(MAP_FAILED)
+    , m_sqRingSize(0)
+    , m_cqRing(MAP_FAILED)
+    , m_cqRingSize(0)
+    , m_sqes((io_uring_sqe*) MAP_FAILED)
+    , m_sqesSize(0)
+    , m_sqLocalTail(0)
+{
+#if defined(__NR_io_uring_setup)
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return;     // ENOSYS, or EPERM when disabled by sysctl or seccomp.
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+        m_sqRingSize = m_cqRingSize = (m_sqRingSize > m_cqRingSize ? m_sqRingSize : m_cqRingSize);
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED)
+    {
+        close(fd);
+        return;
+    }
+    if (singleMmap)
+        m_cqRing = m_sqRing;
+    else
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = (io_uring_sqe*) mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (m_cqRing == MAP_FAILED || m_sqes == MAP_FAILED)
+    {
+        unmapRings();
+        close(fd);
+        return;
+    }
+
+    char* sq = (char*) m_sqRing;
+    char* cq = (char*) m_cqRing;
+    m_sqHead = (std::atomic<uint32_t>*) (sq + params.sq_off.head);
+    m_sqTail = (std::atomic<uint32_t>*) (sq + params.sq_off.tail);
+    m_sqArray = (uint32_t*) (sq + params.sq_off.array);
+    m_sqMask = *(uint32_t*) (sq + params.sq_off.ring_mask);
+    m_sqEntries = params.sq_entries;
+    m_sqLocalTail = m_sqTail->load(std::memory_order_relaxed);
+    m_cqHead = (std::atomic<uint32_t>*) (cq + params.cq_off.head);
+    m_cqTail = (std::atomic<uint32_t>*) (cq + params.cq_off.tail);
+    m_cqes = (io_uring_cqe*) (cq + params.cq_off.cqes);
+    m_cqMask = *(uint32_t*) (cq + params.cq_off.ring_mask);
+    m_fd = fd;
+#else
+    (void) entries;
+#endif
+}
+
+IoUring::~IoUring()
+{
+    unmapRings();
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+void IoUring::unmapRings()
+{
+    if (m_sqes != MAP_FAILED)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing != MAP_FAILED)
+        munmap(m_sqRing, m_sqRingSize);
+    m_sqes = (io_uring_sqe*) MAP_FAILED;
+    m_sqRing = m_cqRing = MAP_FAILED;
+}
+
+io_uring_sqe* IoUring::getSqe()
+{
+    assert(isValid());
+    uint32_t head = m_sqHead->load(std::memory_order_acquire);
+    if (m_sqLocalTail - head >= m_sqEntries)
+        return nullptr;
+    uint32_t index = m_sqLocalTail & m_sqMask;
+    m_sqArray[index] = index;
+    m_sqLocalTail++;
+    io_uring_sqe* sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::submit(unsigned int waitFor)
+{
+    assert(isValid());
+    // Publish the SQEs. Pairs with the kernel's acquire of the tail.
+    uint32_t toSubmit = m_sqLocalTail - m_sqTail->load(std::memory_order_relaxed);
+    m_sqTail->store(m_sqLocalTail, std::memory_order_release);
+    for (;;)
+    {
+#if defined(__NR_io_uring_enter)
+        long rc = syscall(__NR_io_uring_enter, m_fd, toSubmit, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+#else
+        long rc = -1;
+        errno = ENOSYS;
+#endif
+        if (rc >= 0)
+            return (int) rc;
+        if (errno != EINTR)
+            return -errno;
+    }
+}
+
+bool IoUring::popCompletion(io_uring_cqe& cqe)
+{
+    assert(isValid());
+    uint32_t head = m_cqHead->load(std::memory_order_relaxed);
+    if (head == m_cqTail->load(std::memory_order_acquire))
+        return false;
+    cqe = m_cqes[head & m_cqMask];
+    // Let the kernel reuse the slot only after we've copied it.
+    m_cqHead->store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool IoUring::supportsOp(int op)
+{
+    assert(isValid());
+#if defined(__NR_io_uring_register)
+    const int MAX_OPS = 256;
+    std::vector<char> buffer(sizeof(CPP11OM_IoUringProbe) + MAX_OPS * sizeof(CPP11OM_IoUringProbeOp), 0);
+    CPP11OM_IoUringProbe* probe = (CPP11OM_IoUringProbe*) buffer.data();
+    CPP11OM_IoUringProbeOp* ops = (CPP11OM_IoUringProbeOp*) (probe + 1);
+    if (syscall(__NR_io_uring_register, m_fd, CPP11OM_IORING_REGISTER_PROBE, probe, MAX_OPS) < 0)
+        return false;   // Linux < 5.6
+    return op <= probe->lastOp && (ops[op].flags & CPP11OM_IO_URING_OP_SUPPORTED) != 0;
+#else
+    (void) op;
+    return false;
+#endif
+}
+
+void IoUring::prepPollAdd(io_uring_sqe* sqe, int fd, uint64_t userData)
+{
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    // poll32_events only exists in Linux 5.9+ headers. POLLIN fits in the 16-bit field,
+    // which newer kernels still accept, on either endianness.
+    sqe->poll_events = POLLIN;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepFutexWait(io_uring_sqe* sqe, std::atomic<uint32_t>* word, uint32_t expected, uint64_t userData)
+{
+    sqe->opcode = OP_FUTEX_WAIT;
+    sqe->fd = CPP11OM_FUTEX2_SIZE_U32 | CPP11OM_FUTEX2_PRIVATE;
+    sqe->addr = (uint64_t) (uintptr_t) word;
+    sqe->addr2 = expected;
+    sqe->addr3 = FUTEX_BITSET_MATCH_ANY;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepCancel(io_uring_sqe* sqe, uint64_t targetUserData, uint64_t userData)
+{
+    sqe->opcode = CPP11OM_IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = targetUserData;
+    sqe->user_data = userData;
+}
+
+
+//---------------------------------------------------------
+// UringFutexWaitHelper
+//---------------------------------------------------------
+UringFutexWaitHelper::UringFutexWaitHelper()
+    : m_word(nullptr)
+    , m_stop(false)
+    , m_cancel(false)
+{
+    m_thread = std::thread(&UringFutexWaitHelper::threadFunc, this);
+}
+
+UringFutexWaitHelper::~UringFutexWaitHelper()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+    m_requests.signal();
+    // The thread may be blocked on the futex. A spurious wake-up is harmless to other waiters.
+    std::atomic<uint32_t>* word = m_word.load(std::memory_order_relaxed);
+    if (word)
+        syscall(SYS_futex, (uint32_t*) word, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+    m_thread.join();
+}
+
+void UringFutexWaitHelper::request(std::atomic<uint32_t>* word)
+{
+    m_word.store(word, std::memory_order_relaxed);
+    m_requests.signal();
+}
+
+void UringFutexWaitHelper::cancel()
+{
+    m_cancel.store(true, std::memory_order_relaxed);
+    // Like the destructor, wake the thread if it's blocked on the futex.
+    std::atomic<uint32_t>* word = m_word.load(std::memory_order_relaxed);
+    syscall(SYS_futex, (uint32_t*) word, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+    // The thread signals m_ready once per request, even a cancelled one. Consume it.
+    m_ready.wait();
+    m_cancel.store(false, std::memory_order_relaxed);
+}
+
+void UringFutexWaitHelper::threadFunc()
+{
+    for (;;)
+    {
+        m_requests.wait();
+        if (m_stop.load(std::memory_order_relaxed))
+            break;
+        std::atomic<uint32_t>* word = m_word.load(std::memory_order_relaxed);
+        while (word->load(std::memory_order_acquire) == 0)
+        {
+            if (m_stop.load(std::memory_order_relaxed))
+                return;
+            if (m_cancel.load(std::memory_order_relaxed))
+                break;
+            // The FUTEX_WAKE from cancel() or the destructor can slip in between the checks
+            // above and this wait, so don't sleep indefinitely.
+            struct timespec timeout = { 0, 100 * 1000 * 1000 };
+            syscall(SYS_futex, (uint32_t*) word, FUTEX_WAIT_PRIVATE, 0, &timeout, nullptr, 0);
+        }
+        m_ready.signal();
+    }
+}
+
+#endif // CPP11OM_HAVE_IO_URING
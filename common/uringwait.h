@@ -0,0 +1,269 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_URING_WAIT_H__
+#define __CPP11OM_URING_WAIT_H__
+
+// <linux/io_uring.h> is only installed with Linux 5.1+ kernel headers.
+#if defined(__linux__)
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define CPP11OM_HAVE_IO_URING 1
+#endif
+#else
+#define CPP11OM_HAVE_IO_URING 1
+#endif
+#endif
+#ifndef CPP11OM_HAVE_IO_URING
+#define CPP11OM_HAVE_IO_URING 0
+#endif
+
+#if CPP11OM_HAVE_IO_URING
+
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <linux/io_uring.h>
+#include "sema.h"
+
+
+//---------------------------------------------------------
+// IoUring
+// Just enough of an io_uring, through raw syscalls, to drive the waits below without
+// depending on liburing. If you already have a ring, skip this class and pass UringWait
+// SQEs from your own; the SQE layout is the kernel's.
+// isValid() is false if the kernel doesn't support io_uring, or it has been disabled.
+// Not thread-safe: a ring belongs to the one thread that drives it.
+//---------------------------------------------------------
+class IoUring
+{
+private:
+    int m_fd;
+    void* m_sqRing;
+    size_t m_sqRingSize;
+    void* m_cqRing;
+    size_t m_cqRingSize;
+    io_uring_sqe* m_sqes;
+    size_t m_sqesSize;
+    // The kernel reads and writes the ring indices concurrently; treat them as atomics, as liburing does.
+    std::atomic<uint32_t>* m_sqHead;
+    std::atomic<uint32_t>* m_sqTail;
+    uint32_t* m_sqArray;
+    uint32_t m_sqMask;
+    uint32_t m_sqEntries;
+    uint32_t m_sqLocalTail;     // Includes SQEs handed out by getSqe() but not submitted yet.
+    std::atomic<uint32_t>* m_cqHead;
+    std::atomic<uint32_t>* m_cqTail;
+    io_uring_cqe* m_cqes;
+    uint32_t m_cqMask;
+
+    IoUring(const IoUring& other) = delete;
+    IoUring& operator=(const IoUring& other) = delete;
+
+    void unmapRings();
+
+public:
+    IoUring(unsigned int entries = 64);
+    ~IoUring();
+
+    bool isValid() const
+    {
+        return m_fd >= 0;
+    }
+
+    // Returns a zeroed SQE to fill in, or nullptr if the submission queue is full.
+    io_uring_sqe* getSqe();
+
+    // Submits every SQE obtained from getSqe(), then blocks until at least waitFor completions are available.
+    // Returns the number of SQEs submitted, or -errno.
+    int submit(unsigned int waitFor = 0);
+
+    // Copies out the oldest completion, if any.
+    bool popCompletion(io_uring_cqe& cqe);
+
+    // Asks the kernel whether it implements the given IORING_OP_*.
+    bool supportsOp(int op);
+
+    static void prepPollAdd(io_uring_sqe* sqe, int fd, uint64_t userData);
+    // Completes once *word no longer equals expected, or FUTEX_WAKE is called on it.
+    static void prepFutexWait(io_uring_sqe* sqe, std::atomic<uint32_t>* word, uint32_t expected, uint64_t userData);
+    // Cancels the SQE that was submitted with targetUserData. Linux 5.5+.
+    static void prepCancel(io_uring_sqe* sqe, uint64_t targetUserData, uint64_t userData);
+
+    // Not in older <linux/io_uring.h> headers. Linux 6.7+.
+    static const int OP_FUTEX_WAIT = 51;
+};
+
+
+//---------------------------------------------------------
+// UringFutexWaitHelper
+// Used by UringWait when the ring can't wait on a futex itself. A helper thread blocks on
+// the futex word instead, then signals an eventfd that the ring can poll.
+//---------------------------------------------------------
+class UringFutexWaitHelper
+{
+private:
+    std::atomic<std::atomic<uint32_t>*> m_word;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_cancel;
+    LightweightSemaphore m_requests;
+    EventfdSemaphore m_ready;
+    std::thread m_thread;
+
+    UringFutexWaitHelper(const UringFutexWaitHelper& other) = delete;
+    UringFutexWaitHelper& operator=(const UringFutexWaitHelper& other) = delete;
+
+    void threadFunc();
+
+public:
+    UringFutexWaitHelper();
+    ~UringFutexWaitHelper();
+
+    // Starts waiting for *word to become non-zero. fd() becomes readable once it has.
+    void request(std::atomic<uint32_t>* word);
+
+    int fd() const
+    {
+        return m_ready.fd();
+    }
+
+    // Call once fd() polls readable.
+    void acknowledge()
+    {
+        bool ok = m_ready.tryWait();
+        assert(ok);
+        (void) ok;
+    }
+
+    // Abandons the current request, whether or not fd() has become readable, and leaves
+    // fd() unreadable for the next one.
+    void cancel();
+};
+
+
+//---------------------------------------------------------
+// UringWait
+// Lets a thread that's driven by an io_uring wait on a LightweightSemaphore or AutoResetEvent
+// (Waitable) without blocking, so that its completion arrives alongside disk and network
+// completions. Waitable must use a kernel semaphore the ring can wait on, through the
+// pollable wait protocol in sema.h:
+// - EventfdSemaphore (PollableSemaphore, PollableAutoResetEvent): the ring polls the eventfd.
+// - FutexSemaphore (FutexLightweightSemaphore, FutexAutoResetEvent): the ring waits on the
+//   futex word with IORING_OP_FUTEX_WAIT, if the kernel supports it. Otherwise, a helper
+//   thread blocks on the futex and wakes the ring through an eventfd.
+// Usage: If begin() returns true, the wait is already over. Otherwise, fill an SQE with
+// prepare() and submit it. When its completion arrives, pass its result to complete().
+// If that returns false, the wake-up went to another waiter; prepare() and submit again.
+// To abandon the wait, first cancel the SQE with IORING_OP_ASYNC_CANCEL and reap its
+// completion, then call cancel(), which returns true if the wait succeeded anyway.
+// A UringWait handles one wait at a time.
+//---------------------------------------------------------
+template <class Waitable>
+class UringWait
+{
+private:
+    Waitable& m_target;
+    bool m_useFutexOp;
+    std::unique_ptr<UringFutexWaitHelper> m_helper;     // Created the first time it's needed
+    bool m_helperRequested;
+    bool m_kernelWaitPrepared;      // An SQE from prepare() hasn't been passed to complete() or cancel() yet.
+
+    UringWait(const UringWait& other) = delete;
+    UringWait& operator=(const UringWait& other) = delete;
+
+    void prepareKernelWait(io_uring_sqe* sqe, uint64_t userData, EventfdSemaphore& sema)
+    {
+        IoUring::prepPollAdd(sqe, sema.fd(), userData);
+    }
+
+    void prepareKernelWait(io_uring_sqe* sqe, uint64_t userData, FutexSemaphore& sema)
+    {
+        // Makes signal() issue FUTEX_WAKE, which both the ring and the helper thread depend on.
+        sema.addWaiter();
+        if (m_useFutexOp)
+        {
+            // FutexSemaphore::signal() makes the count non-zero, then wakes the word.
+            IoUring::prepFutexWait(sqe, sema.futexWord(), 0, userData);
+            return;
+        }
+        if (!m_helper)
+            m_helper = std::unique_ptr<UringFutexWaitHelper>(new UringFutexWaitHelper);
+        m_helper->request(sema.futexWord());
+        m_helperRequested = true;
+        IoUring::prepPollAdd(sqe, m_helper->fd(), userData);
+    }
+
+    // Undoes prepareKernelWait's registration once its SQE has completed.
+    void finishKernelWait(EventfdSemaphore&)
+    {
+    }
+
+    void finishKernelWait(FutexSemaphore& sema)
+    {
+        sema.removeWaiter();
+    }
+
+public:
+    // Pass ring.supportsOp(IoUring::OP_FUTEX_WAIT) as ringSupportsFutexWait, or the same
+    // answer from liburing's io_uring_get_probe().
+    UringWait(Waitable& target, bool ringSupportsFutexWait)
+    : m_target(target)
+    , m_useFutexOp(ringSupportsFutexWait)
+    , m_helperRequested(false)
+    , m_kernelWaitPrepared(false)
+    {}
+
+    bool begin()
+    {
+        return m_target.beginPollableWait();
+    }
+
+    void prepare(io_uring_sqe* sqe, uint64_t userData)
+    {
+        prepareKernelWait(sqe, userData, m_target.kernelSemaphore());
+        m_kernelWaitPrepared = true;
+    }
+
+    bool complete(int32_t res)
+    {
+        (void) res;     // Success, -EAGAIN (the futex word already changed) or -EINTR all mean: try now.
+        if (m_kernelWaitPrepared)
+        {
+            finishKernelWait(m_target.kernelSemaphore());
+            m_kernelWaitPrepared = false;
+        }
+        if (m_helperRequested)
+        {
+            m_helper->acknowledge();
+            m_helperRequested = false;
+        }
+        return m_target.finishPollableWait();
+    }
+
+    bool cancel()
+    {
+        // The helper thread signals its eventfd exactly once per request. Take that signal
+        // now, so that the next request doesn't find the eventfd already readable.
+        if (m_helperRequested)
+        {
+            m_helper->cancel();
+            m_helperRequested = false;
+        }
+        if (m_kernelWaitPrepared)
+        {
+            finishKernelWait(m_target.kernelSemaphore());
+            m_kernelWaitPrepared = false;
+        }
+        return m_target.cancelPollableWait();
+    }
+};
+
+
+#endif // CPP11OM_HAVE_IO_URING
+
+#endif // __CPP11OM_URING_WAIT_H__
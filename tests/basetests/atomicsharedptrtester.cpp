@@ -0,0 +1,135 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+#include "atomicsharedptr.h"
+
+
+//---------------------------------------------------------
+// AtomicSharedPtrTester
+// One thread keeps publishing new versions of a Config, whose fields are all derived from its
+// version number, while the other threads load snapshots and check them. A snapshot must be
+// internally consistent, and must still be intact after a few more versions have been published,
+// and each reader must see version numbers that never go backwards. At the end, every Config
+// except the current one must have been destroyed.
+//---------------------------------------------------------
+class AtomicSharedPtrTester
+{
+private:
+    static const int ARRAY_LENGTH = 8;
+
+    struct Config
+    {
+        static std::atomic<int> s_liveCount;
+
+        int version;
+        int values[ARRAY_LENGTH];
+
+        Config(int v) : version(v)
+        {
+            for (int j = 0; j < ARRAY_LENGTH; j++)
+                values[j] = v + j;
+            s_liveCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ~Config()
+        {
+            // Poison it, so that a reader using a destroyed snapshot will notice.
+            for (int j = 0; j < ARRAY_LENGTH; j++)
+                values[j] = -1;
+            s_liveCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        bool isConsistent() const
+        {
+            for (int j = 0; j < ARRAY_LENGTH; j++)
+            {
+                if (values[j] != version + j)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    AtomicSharedPtr<Config> m_config;
+    int m_iterationCount;
+    std::atomic<bool> m_writerDone;
+    std::atomic<bool> m_success;
+
+public:
+    AtomicSharedPtrTester()
+    : m_iterationCount(0)
+    , m_writerDone(false)
+    , m_success(false)
+    {}
+
+    void writerFunc()
+    {
+        for (int i = 1; i <= m_iterationCount; i++)
+        {
+            m_config.store(std::make_shared<Config>(i));
+            if (i % 64 == 0)
+                std::this_thread::yield();
+        }
+        m_writerDone.store(true, std::memory_order_release);
+    }
+
+    void readerFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+        int lastVersion = 0;
+        std::shared_ptr<Config> held;     // An older snapshot, kept alive across later loads
+
+        while (!m_writerDone.load(std::memory_order_acquire))
+        {
+            std::shared_ptr<Config> config = m_config.load();
+            bool ok = config && config->isConsistent() && config->version >= lastVersion;
+            if (ok)
+                lastVersion = config->version;
+            if (held && !held->isConsistent())
+                ok = false;
+            if (std::uniform_int_distribution<>(0, 15)(randomEngine) == 0)
+                held = config;
+            if (!ok)
+                m_success.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    bool test(int readerCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+        m_writerDone.store(false, std::memory_order_relaxed);
+        m_success.store(true, std::memory_order_relaxed);
+        m_config.store(std::make_shared<Config>(0));
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < readerCount; i++)
+            threads.emplace_back(&AtomicSharedPtrTester::readerFunc, this, i);
+        threads.emplace_back(&AtomicSharedPtrTester::writerFunc, this);
+        for (std::thread& t : threads)
+            t.join();
+
+        if (m_config.load()->version != iterationCount)
+            return false;
+        if (Config::s_liveCount.load(std::memory_order_relaxed) != 1)
+            return false;
+        m_config.store(std::shared_ptr<Config>());
+        if (m_config.load() || Config::s_liveCount.load(std::memory_order_relaxed) != 0)
+            return false;
+        return m_success.load(std::memory_order_relaxed);
+    }
+};
+
+std::atomic<int> AtomicSharedPtrTester::Config::s_liveCount(0);
+
+bool testAtomicSharedPtr()
+{
+    AtomicSharedPtrTester tester;
+    return tester.test(4, 100000);
+}
@@ -5,17 +5,22 @@
 
 #include <vector>
 #include <mutex>
+#include <thread>
+#include <chrono>
+#include <type_traits>
 #include "benaphore.h"
+#include "pilock.h"
 
 
 //---------------------------------------------------------
 // BenaphoreTester
 //---------------------------------------------------------
+template <class LockType>
 class BenaphoreTester
 {
 private:
     int m_iterationCount;
-    NonRecursiveBenaphore m_mutex;
+    LockType m_mutex;
     int m_value;
 
 public:
@@ -45,10 +50,131 @@ public:
 
         return (m_value == threadCount * iterationCount);
     }
+
+    const LockType& lock() const
+    {
+        return m_mutex;
+    }
 };
 
 bool testBenaphore()
 {
-    BenaphoreTester tester;
+    BenaphoreTester<NonRecursiveBenaphore> tester;
+    return tester.test(4, 400000);
+}
+
+bool testPriorityInheritanceLock()
+{
+    if (!PriorityInheritanceLock::isSupported())
+    {
+#if defined(_WIN32)
+        // Nothing to inherit on Windows. Still check that the fallback excludes.
+        BenaphoreTester<PriorityInheritanceLock> tester;
+        return tester.test(4, 400000);
+#else
+        return false;
+#endif
+    }
+
+#if defined(__linux__)
+    // While we hold the lock, a contending thread must end up queued in the kernel's PI
+    // futex, behind us. That's what lets the kernel boost the owner.
+    {
+        PriorityInheritanceLock lock;
+        lock.lock();
+        std::thread waiter([&]() { lock.lock(); lock.unlock(); });
+        bool queued = false;
+        for (int i = 0; i < 5000 && !queued; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            queued = lock.hasKernelWaiters();
+        }
+        lock.unlock();
+        waiter.join();
+        if (!queued || lock.hasKernelWaiters())
+            return false;
+    }
+#endif
+
+    BenaphoreTester<PriorityInheritanceLock> tester;
     return tester.test(4, 400000);
 }
+
+// A few non-default compositions. Each lock is counted, so the stats must add up.
+template <class LockType>
+bool testBenaphoreComposition()
+{
+    BenaphoreTester<LockType> tester;
+    if (!tester.test(4, 100000))
+        return false;
+    const ContentionStats& stats = tester.lock().stats();
+    return stats.uncontended() + stats.kernelWaits() == 4 * 100000;
+}
+
+bool testBenaphorePolicies()
+{
+    typedef BasicLightweightSemaphore<Semaphore, AdaptiveSpin> AdaptiveSemaphore;
+    typedef BasicNonRecursiveBenaphore<AdaptiveSemaphore, ContentionStats, CacheLineAlignment> AlignedLock;
+    if (std::alignment_of<AlignedLock>::value != 64 || sizeof(AlignedLock) % 64 != 0)
+        return false;
+    if (!testBenaphoreComposition<AlignedLock>())
+        return false;
+#if defined(__linux__)
+    typedef BasicLightweightSemaphore<FutexSemaphore, NoSpin> NoSpinFutexSemaphore;
+    if (!testBenaphoreComposition<BasicNonRecursiveBenaphore<NoSpinFutexSemaphore, ContentionStats>>())
+        return false;
+#endif
+    return true;
+}
+
+// Slots must be recycled as threads exit, the parked flag must follow a thread into a kernel
+// wait, and a lock that spins only while its owner runs must still be a lock.
+bool testOwnerAwareSpin()
+{
+    ThreadRunState::enable();     // Normally done by the first OwnerAwareSpin.
+    int index = ThreadRunState::currentIndex();
+    if (index == ThreadRunState::NO_INDEX || !ThreadRunState::isRunning(index))
+        return false;
+
+    // More threads than there are slots, one after another. Each one must get a slot.
+    for (int i = 0; i < ThreadRunState::MAX_THREADS + 16; i++)
+    {
+        int threadIndex = ThreadRunState::NO_INDEX;
+        std::thread t([&]() { threadIndex = ThreadRunState::currentIndex(); });
+        t.join();
+        if (threadIndex == ThreadRunState::NO_INDEX)
+            return false;
+    }
+
+    BasicLightweightSemaphore<Semaphore, NoSpin> sema;
+    std::atomic<bool> started(false);
+    std::atomic<int> waiterIndex(ThreadRunState::NO_INDEX);
+    std::thread waiter([&]()
+    {
+        waiterIndex.store(ThreadRunState::currentIndex(), std::memory_order_relaxed);
+        started.store(true, std::memory_order_release);
+        sema.wait();
+    });
+    while (!started.load(std::memory_order_acquire))
+        std::this_thread::yield();
+    // Give up after a while, rather than hang, if the waiter is never marked as parked.
+    bool parked = false;
+    int waiterSlot = waiterIndex.load(std::memory_order_relaxed);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (waiterSlot != ThreadRunState::NO_INDEX && !parked && std::chrono::steady_clock::now() < deadline)
+    {
+        parked = !ThreadRunState::isRunning(waiterSlot);
+        std::this_thread::yield();
+    }
+    sema.signal();
+    waiter.join();
+    if (!parked)
+        return false;
+
+    typedef BasicNonRecursiveBenaphore<BasicLightweightSemaphore<Semaphore, NoSpin>, ContentionStats, NoAlignment, OwnerAwareSpin<>> OwnerAwareLock;
+    BenaphoreTester<OwnerAwareLock> tester;
+    if (!tester.test(4, 100000))
+        return false;
+    const ContentionStats& stats = tester.lock().stats();
+    return stats.uncontended() + stats.spinSuccesses() + stats.kernelWaits() == 4 * 100000;
+}
@@ -0,0 +1,90 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <map>
+#include "compactinmemorylogger.h"
+#include "inmemorylogger.h"
+
+
+//---------------------------------------------------------
+// CompactLoggerTester
+// Logs a deterministic sequence of events from each thread, then checks that the
+// decoded log reproduces every sequence exactly and is at least twice as compact
+// as InMemoryLogger.
+//---------------------------------------------------------
+class CompactLoggerTester
+{
+private:
+    static const size_t PARAMS_PER_THREAD = 1000000;
+    static const char* const MESSAGES[3];
+    CompactInMemoryLogger m_logger;
+    int m_iterationCount;
+
+public:
+    CompactLoggerTester() : m_iterationCount(0) {}
+
+    void threadFunc(int threadNum)
+    {
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            // The param identifies both the thread and the iteration.
+            m_logger.log(MESSAGES[i % 3], threadNum * PARAMS_PER_THREAD + i);
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&CompactLoggerTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        // Replay event log to make sure it's OK.
+        bool ok = true;
+        std::vector<int> nextIteration(threadCount);
+        std::map<std::thread::id, int> threadNums;
+        uint64_t lastTimestamp = 0;
+        size_t numEvents = 0;
+        for (const auto& evt : m_logger)
+        {
+            int threadNum = int(evt.param / PARAMS_PER_THREAD);
+            int i = int(evt.param % PARAMS_PER_THREAD);
+            if (threadNum >= threadCount || i != nextIteration[threadNum] || evt.msg != MESSAGES[i % 3])
+                ok = false;
+            else
+                nextIteration[threadNum]++;
+            auto inserted = threadNums.insert(std::make_pair(evt.tid, threadNum));
+            if (inserted.first->second != threadNum)
+                ok = false;
+            if (evt.timestamp < lastTimestamp)
+                ok = false;
+            lastTimestamp = evt.timestamp;
+            numEvents++;
+        }
+        for (int n : nextIteration)
+        {
+            if (n != iterationCount)
+                ok = false;
+        }
+        if (numEvents != m_logger.eventCount())
+            ok = false;
+        if (m_logger.bytesUsed() * 2 > numEvents * sizeof(InMemoryLogger::Event))
+            ok = false;
+        return ok;
+    }
+};
+
+const char* const CompactLoggerTester::MESSAGES[3] = { "lock", "unlock", "wait" };
+
+bool testCompactLogger()
+{
+    CompactLoggerTester tester;
+    return tester.test(4, 200000);
+}
@@ -7,36 +7,168 @@
 #include <random>
 #include <string>
 #include <thread>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include "diningphilosophers.h"
 #include "inmemorylogger.h"
 
 
+//---------------------------------------------------------
+// DiningPhilosopherMonitor
+// Checks the log while the philosophers are still running, so that a long soak test can
+// stop as soon as something goes wrong, instead of finding out from the replay at the end.
+// Flags two neighbors eating at once, and any philosopher that stays hungry for longer
+// than maxWait. Waits are timed from when the monitor reads the "hungry" event, so a
+// philosopher that never gets to eat is caught even though it never logs again.
+// Meant to be run on its own thread. Only failed() may be called from other threads.
+//---------------------------------------------------------
+class DiningPhilosopherMonitor
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    InMemoryLogger::Reader m_reader;
+    int m_numPhilos;
+    Clock::duration m_maxWait;
+    std::vector<char> m_isEating;
+    std::vector<char> m_isHungry;
+    std::vector<Clock::time_point> m_hungrySince;
+    std::atomic<bool> m_failed;
+
+    void fail()
+    {
+        m_failed.store(true, std::memory_order_relaxed);
+    }
+
+    void handle(const InMemoryLogger::Event& evt)
+    {
+        int philoIndex = (int) evt.param;
+        const char* msg = evt.msg;
+        if (std::strcmp(msg, "hungry") == 0)
+        {
+            m_isHungry[philoIndex] = 1;
+            m_hungrySince[philoIndex] = Clock::now();
+        }
+        else if (std::strcmp(msg, "eat") == 0)
+        {
+            if (m_isEating[philoIndex]
+                || m_isEating[DiningPhiloHelpers::left(philoIndex, m_numPhilos)]
+                || m_isEating[DiningPhiloHelpers::right(philoIndex, m_numPhilos)])
+                fail();
+            m_isHungry[philoIndex] = 0;
+            m_isEating[philoIndex] = 1;
+        }
+        else
+        {
+            assert(std::strcmp(msg, "think") == 0);
+            if (!m_isEating[philoIndex])
+                fail();
+            m_isEating[philoIndex] = 0;
+        }
+    }
+
+public:
+    DiningPhilosopherMonitor(InMemoryLogger& logger, int numPhilos, Clock::duration maxWait)
+        : m_reader(logger)
+        , m_numPhilos(numPhilos)
+        , m_maxWait(maxWait)
+        , m_isEating(numPhilos)
+        , m_isHungry(numPhilos)
+        , m_hungrySince(numPhilos)
+        , m_failed(false)
+    {
+    }
+
+    bool failed() const
+    {
+        return m_failed.load(std::memory_order_relaxed);
+    }
+
+    // Consumes every event logged so far, then checks how long the hungry philosophers have waited.
+    void poll()
+    {
+        while (const InMemoryLogger::Event* evt = m_reader.tryRead())
+            handle(*evt);
+        Clock::time_point now = Clock::now();
+        for (int i = 0; i < m_numPhilos; i++)
+        {
+            if (m_isHungry[i] && now - m_hungrySince[i] > m_maxWait)
+                fail();
+        }
+    }
+
+    // Polls every millisecond until stop is set or a violation is found. Once stop is set,
+    // the philosophers are done, so it drains the rest of the log and checks that nobody is
+    // still eating. Returns as soon as it finds a violation, even if stop is never set.
+    void run(const std::atomic<bool>& stop)
+    {
+        // Acquire, so that the last poll sees every event logged before stop was set.
+        while (!failed() && !stop.load(std::memory_order_acquire))
+        {
+            poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        poll();
+        for (int i = 0; i < m_numPhilos; i++)
+        {
+            if (m_isEating[i] || m_isHungry[i])
+                fail();
+        }
+    }
+};
+
+
 //---------------------------------------------------------
 // DiningPhilosopherTester
+// The calling thread runs the monitor while the philosophers eat. If the monitor finds a
+// problem, test() returns false without waiting for a philosopher that's stuck in
+// beginEating(). Its thread is still running, so call unstall() or abandon() afterwards.
 //---------------------------------------------------------
 class DiningPhilosopherTester
 {
 private:
     InMemoryLogger m_logger;
     std::unique_ptr<DefaultDiningPhilosophersType> m_philosophers;
+    std::unique_ptr<DiningPhilosopherMonitor> m_monitor;
+    std::vector<std::thread> m_threads;
     int m_iterationCount;
+    int m_stalledPhilo;             // For testing the monitor. Waits on m_unstall before its first meal.
+    LightweightSemaphore m_unstall;
+    std::atomic<int> m_running;     // Philosophers that haven't finished yet
+    std::atomic<bool> m_allDone;
+
+    void joinAll()
+    {
+        for (std::thread& t : m_threads)
+            t.join();
+        m_threads.clear();
+    }
 
 public:
-    DiningPhilosopherTester() : m_iterationCount(0) {}
+    DiningPhilosopherTester() : m_iterationCount(0), m_stalledPhilo(-1), m_running(0), m_allDone(false) {}
+
+    ~DiningPhilosopherTester()
+    {
+        assert(m_threads.empty());
+    }
 
     void threadFunc(int philoIndex)
     {
         std::random_device rd;
         std::mt19937 randomEngine(rd());
 
-        for (int i = 0; i < m_iterationCount; i++)
+        // Stop early if the monitor has already found a problem.
+        for (int i = 0; i < m_iterationCount && !m_monitor->failed(); i++)
         {
             // Do a random amount of work.
             int workUnits = std::uniform_int_distribution<int>(0, 100)(randomEngine);
             for (int j = 0; j < workUnits; j++)
                 randomEngine();
 
+            m_logger.log("hungry", philoIndex);
+            if (philoIndex == m_stalledPhilo && i == 0)
+                m_unstall.wait();
             m_philosophers->beginEating(philoIndex);
             m_logger.log("eat", philoIndex);
 
@@ -48,23 +180,18 @@ public:
             m_logger.log("think", philoIndex);
             m_philosophers->endEating(philoIndex);
         }
+
+        // Release, so that the monitor sees every philosopher's events once m_allDone is set.
+        if (m_running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            m_allDone.store(true, std::memory_order_release);
     }
 
-    bool test(int numPhilos, int iterationCount)
+    // Replay event log to make sure it's OK.
+    static bool replay(InMemoryLogger& logger, int numPhilos)
     {
-        m_iterationCount = iterationCount;
-        m_philosophers = std::unique_ptr<DefaultDiningPhilosophersType>(new DefaultDiningPhilosophersType(numPhilos));
-
-        std::vector<std::thread> threads;
-        for (int i = 0; i < numPhilos; i++)
-            threads.emplace_back(&DiningPhilosopherTester::threadFunc, this, i);
-        for (std::thread& t : threads)
-            t.join();
-
-        // Replay event log to make sure it's OK.
         std::vector<char> isEating(numPhilos);
         bool ok = true;
-        for (const auto& evt : m_logger)
+        for (const auto& evt : logger)
         {
             int philoIndex = (int) evt.param;
             if (std::strcmp(evt.msg, "eat") == 0)
@@ -77,9 +204,8 @@ public:
                     ok = false;
                 isEating[philoIndex] = 1;
             }
-            else
+            else if (std::strcmp(evt.msg, "think") == 0)
             {
-                assert(std::strcmp(evt.msg, "think") == 0);
                 if (!isEating[philoIndex])
                     ok = false;
                 isEating[philoIndex] = 0;
@@ -90,15 +216,231 @@ public:
             if (s)
                 ok = false;
         }
+        return ok;
+    }
+
+    // What a single page of the log says about each philosopher, without knowing what came before.
+    struct PageSummary
+    {
+        std::vector<char> touched;          // Philosopher has an event on this page.
+        std::vector<char> endsEating;       // Its state after its last event on this page.
+        std::vector<char> mustStartIdle;    // The page is only OK if it wasn't eating when the page began,
+        std::vector<char> mustStartEating;  // or only if it was.
+        bool ok;
+
+        PageSummary() : ok(true) {}
+    };
+
+    struct ReplayState
+    {
+        std::vector<char> isEating;
+        bool ok;
+    };
+
+    // Same check as replay(), but summarizes the pages in parallel, then reconciles the
+    // summaries in order.
+    static bool replayParallel(const InMemoryLogger& logger, int numPhilos)
+    {
+        auto summarize = [numPhilos](const InMemoryLogger::Event* events, int count)
+        {
+            PageSummary page;
+            page.touched.resize(numPhilos);
+            page.endsEating.resize(numPhilos);
+            page.mustStartIdle.resize(numPhilos);
+            page.mustStartEating.resize(numPhilos);
+            // Checks a philosopher that isn't allowed to be eating right now.
+            auto requireIdle = [&](int p)
+            {
+                if (!page.touched[p])
+                    page.mustStartIdle[p] = 1;
+                else if (page.endsEating[p])
+                    page.ok = false;
+            };
+            for (int i = 0; i < count; i++)
+            {
+                int philoIndex = (int) events[i].param;
+                if (std::strcmp(events[i].msg, "eat") == 0)
+                {
+                    requireIdle(philoIndex);
+                    requireIdle(DiningPhiloHelpers::left(philoIndex, numPhilos));
+                    requireIdle(DiningPhiloHelpers::right(philoIndex, numPhilos));
+                    page.endsEating[philoIndex] = 1;
+                }
+                else if (std::strcmp(events[i].msg, "think") == 0)
+                {
+                    if (!page.touched[philoIndex])
+                        page.mustStartEating[philoIndex] = 1;
+                    else if (!page.endsEating[philoIndex])
+                        page.ok = false;
+                    page.endsEating[philoIndex] = 0;
+                }
+                page.touched[philoIndex] = 1;
+            }
+            return page;
+        };
+        auto merge = [numPhilos](ReplayState& state, const PageSummary& page)
+        {
+            if (!page.ok)
+                state.ok = false;
+            for (int p = 0; p < numPhilos; p++)
+            {
+                if ((page.mustStartIdle[p] && state.isEating[p]) || (page.mustStartEating[p] && !state.isEating[p]))
+                    state.ok = false;
+                if (page.touched[p])
+                    state.isEating[p] = page.endsEating[p];
+            }
+        };
+
+        ReplayState init;
+        init.isEating.resize(numPhilos);
+        init.ok = true;
+        ReplayState result = logger.processPages(init, summarize, merge);
+        for (char s : result.isEating)
+        {
+            if (s)
+                result.ok = false;
+        }
+        return result.ok;
+    }
+
+    // Set stalledPhilo to make that philosopher wait for unstall() before its first meal.
+    bool test(int numPhilos, int iterationCount, std::chrono::milliseconds maxWait, int stalledPhilo = -1)
+    {
+        m_iterationCount = iterationCount;
+        m_stalledPhilo = stalledPhilo;
+        m_philosophers = std::unique_ptr<DefaultDiningPhilosophersType>(new DefaultDiningPhilosophersType(numPhilos));
+        m_monitor = std::unique_ptr<DiningPhilosopherMonitor>(new DiningPhilosopherMonitor(m_logger, numPhilos, maxWait));
+        m_running.store(numPhilos, std::memory_order_relaxed);
+        m_allDone.store(false, std::memory_order_relaxed);
+
+        for (int i = 0; i < numPhilos; i++)
+            m_threads.emplace_back(&DiningPhilosopherTester::threadFunc, this, i);
+        m_monitor->run(m_allDone);
+        if (m_monitor->failed())
+        {
+            // The others stop after their current meal, but a philosopher stuck in
+            // beginEating() never will. Give up on it after a while.
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while (!m_allDone.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (!m_allDone.load(std::memory_order_acquire))
+                return false;
+        }
+        joinAll();
+
+        bool ok = !m_monitor->failed() && replay(m_logger, numPhilos);
+        // The parallel replay must reach the same verdict.
+        if (replayParallel(m_logger, numPhilos) != ok)
+            ok = false;
 
+        m_monitor = nullptr;
         m_philosophers = nullptr;
         return ok;
     }
+
+    // True unless test() gave up on a stuck philosopher.
+    bool finished() const
+    {
+        return m_threads.empty();
+    }
+
+    // Lets the stalled philosopher eat, then waits for everyone to finish.
+    void unstall()
+    {
+        m_unstall.signal();
+        joinAll();
+    }
+
+    // For a philosopher that's really stuck. Its thread still uses the tester, so the
+    // caller must never destroy it.
+    void abandon()
+    {
+        for (std::thread& t : m_threads)
+            t.detach();
+        m_threads.clear();
+    }
 };
 
+// Builds one of several hand-made logs for five philosophers, returning true if it's valid.
+// The interesting events are separated by more than a page of filler, so that replayParallel()
+// has to catch each problem while merging page summaries, not within a single page.
+static bool buildHandMadeLog(InMemoryLogger& logger, int which)
+{
+    // Philosopher 2 eating and thinking doesn't conflict with philosophers 0 or 4.
+    auto filler = [&logger]()
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            logger.log("eat", 2);
+            logger.log("think", 2);
+        }
+    };
+    switch (which)
+    {
+    case 0:     // Valid
+        logger.log("eat", 0);
+        filler();
+        logger.log("think", 0);
+        return true;
+    case 1:     // Neighbors eating at once
+        logger.log("eat", 0);
+        filler();
+        logger.log("eat", 4);
+        logger.log("think", 4);
+        logger.log("think", 0);
+        return false;
+    case 2:     // Eating twice without thinking
+        logger.log("eat", 0);
+        filler();
+        logger.log("eat", 0);
+        logger.log("think", 0);
+        return false;
+    case 3:     // Thinking without eating
+        filler();
+        logger.log("think", 4);
+        return false;
+    default:    // Still eating at the end
+        logger.log("eat", 4);
+        filler();
+        return false;
+    }
+}
+
 bool testDiningPhilosophers()
 {
-    DiningPhilosopherTester tester;
-    return tester.test(5, 10000);
+    std::unique_ptr<DiningPhilosopherTester> tester(new DiningPhilosopherTester);
+    // The wait bound is generous, so that the test doesn't fail on a heavily loaded machine.
+    if (!tester->test(5, 10000, std::chrono::milliseconds(10000)))
+    {
+        if (!tester->finished())
+        {
+            // A philosopher is stuck. Leak the tester, which its thread is still using.
+            tester->abandon();
+            tester.release();
+        }
+        return false;
+    }
+
+    // A philosopher that never gets to eat must be caught, without waiting for it.
+    DiningPhilosopherTester stalledTester;
+    bool caught = !stalledTester.test(5, 1000, std::chrono::milliseconds(50), 2);
+    stalledTester.unstall();
+    if (!caught)
+        return false;
+
+    // Both replays, and the monitor, must agree with the expected verdict, not just with each other.
+    for (int which = 0; which < 5; which++)
+    {
+        InMemoryLogger logger;
+        bool valid = buildHandMadeLog(logger, which);
+        if (DiningPhilosopherTester::replay(logger, 5) != valid || DiningPhilosopherTester::replayParallel(logger, 5) != valid)
+            return false;
+        DiningPhilosopherMonitor monitor(logger, 5, std::chrono::seconds(10));
+        std::atomic<bool> stop(true);
+        monitor.run(stop);
+        if (monitor.failed() == valid)
+            return false;
+    }
+    return true;
 }
 
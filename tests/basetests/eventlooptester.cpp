@@ -0,0 +1,103 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+#include <chrono>
+#include "eventloop.h"
+
+
+//---------------------------------------------------------
+// EventLoopTester
+// Several producers post numbered tasks to every loop of an EventLoopGroup, mixed with
+// delayed tasks. Immediate tasks from a given producer must run in order on each loop,
+// and delayed tasks must not run before they're due.
+// Producers pause at random so that the loops often park, with and without a timeout.
+//---------------------------------------------------------
+class EventLoopTester
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int m_producerCount;
+    int m_iterationCount;
+    std::unique_ptr<EventLoopGroup> m_group;
+    // Indexed by loop * m_producerCount + producer. Each entry is only touched by its loop's thread.
+    std::vector<int> m_nextSequence;
+    std::atomic<int> m_delayedRemaining;
+    std::atomic<bool> m_success;
+
+public:
+    EventLoopTester() : m_producerCount(0), m_iterationCount(0), m_delayedRemaining(0), m_success(false) {}
+
+    void producerFunc(int producer)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            for (int l = 0; l < m_group->size(); l++)
+            {
+                int* nextSequence = &m_nextSequence[l * m_producerCount + producer];
+                m_group->loop(l).post([this, nextSequence, i]
+                {
+                    if (*nextSequence != i)
+                        m_success.store(false, std::memory_order_relaxed);
+                    *nextSequence = i + 1;
+                });
+            }
+
+            if (std::uniform_int_distribution<>(0, 100)(randomEngine) == 0)
+            {
+                uint64_t delay = std::uniform_int_distribution<>(0, 2000)(randomEngine);
+                Clock::time_point due = Clock::now() + std::chrono::microseconds(delay);
+                m_group->next().postDelayed(delay, [this, due]
+                {
+                    if (Clock::now() < due)
+                        m_success.store(false, std::memory_order_relaxed);
+                    m_delayedRemaining.fetch_sub(1, std::memory_order_release);
+                });
+                m_delayedRemaining.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool test(int loopCount, int producerCount, int iterationCount)
+    {
+        m_producerCount = producerCount;
+        m_iterationCount = iterationCount;
+        m_group = std::unique_ptr<EventLoopGroup>(new EventLoopGroup(loopCount));
+        m_nextSequence.assign(loopCount * producerCount, 0);
+        m_success.store(true, std::memory_order_relaxed);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < producerCount; i++)
+            threads.emplace_back(&EventLoopTester::producerFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        // Stopping a loop discards pending delayed tasks, so wait for them first.
+        while (m_delayedRemaining.load(std::memory_order_acquire) != 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        m_group.reset();
+
+        for (int seq : m_nextSequence)
+        {
+            if (seq != iterationCount)
+                return false;
+        }
+        return m_success.load(std::memory_order_relaxed);
+    }
+};
+
+bool testEventLoop()
+{
+    EventLoopTester tester;
+    return tester.test(2, 3, 200000);
+}
@@ -0,0 +1,105 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+#include <functional>
+#include "groupcommit.h"
+
+
+//---------------------------------------------------------
+// GroupCommitTester
+// Threads submit numbered requests, and the flush function appends them to a log.
+// Each request must be flushed exactly once, before its submit() returns, and each
+// thread's requests must reach the log in the order it submitted them.
+// The flush function must never run on two threads at once.
+//---------------------------------------------------------
+class GroupCommitTester
+{
+private:
+    struct Request
+    {
+        int threadNum;
+        int sequence;
+        bool flushed;
+    };
+
+    GroupCommit<Request> m_groupCommit;
+    std::vector<Request> m_log;         // Only touched by the flush function
+    std::atomic<int> m_flushersInside;
+    int m_iterationCount;
+    std::atomic<bool> m_success;
+
+    void flush(const std::vector<Request*>& batch)
+    {
+        if (m_flushersInside.fetch_add(1, std::memory_order_relaxed) != 0)
+            m_success.store(false, std::memory_order_relaxed);
+        for (Request* request : batch)
+        {
+            request->flushed = true;
+            m_log.push_back(*request);
+        }
+        m_flushersInside.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+public:
+    GroupCommitTester()
+    : m_groupCommit(std::bind(&GroupCommitTester::flush, this, std::placeholders::_1))
+    , m_flushersInside(0)
+    , m_iterationCount(0)
+    , m_success(false)
+    {}
+
+    void threadFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            Request request;
+            request.threadNum = threadNum;
+            request.sequence = i;
+            request.flushed = false;
+            m_groupCommit.submit(request);
+            if (!request.flushed)
+                m_success.store(false, std::memory_order_relaxed);
+            if (std::uniform_int_distribution<>(0, 7)(randomEngine) == 0)
+                std::this_thread::yield();
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+        m_success.store(true, std::memory_order_relaxed);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&GroupCommitTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        if (m_log.size() != (size_t) threadCount * iterationCount)
+            return false;
+        std::vector<int> nextSequence(threadCount, 0);
+        for (const Request& request : m_log)
+        {
+            if (request.sequence != nextSequence[request.threadNum]++)
+                return false;
+        }
+        if (m_groupCommit.batchCount() == 0 || m_groupCommit.batchCount() > m_log.size())
+            return false;
+        return m_success.load(std::memory_order_relaxed);
+    }
+};
+
+bool testGroupCommit()
+{
+    GroupCommitTester tester;
+    return tester.test(8, 50000);
+}
@@ -0,0 +1,96 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <map>
+#include "inmemorylogger.h"
+
+
+//---------------------------------------------------------
+// InMemoryLoggerTester
+// Logs a deterministic sequence of events from each thread, then checks that the parallel
+// post-processing API agrees with Iterator: exportColumns() must reproduce the log exactly,
+// and counting events per thread with processPages() must give the right totals.
+//---------------------------------------------------------
+class InMemoryLoggerTester
+{
+private:
+    static const size_t PARAMS_PER_THREAD = 1000000;
+    static const char* const MESSAGES[3];
+    InMemoryLogger m_logger;
+    int m_iterationCount;
+
+public:
+    InMemoryLoggerTester() : m_iterationCount(0) {}
+
+    void threadFunc(int threadNum)
+    {
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            // The param identifies both the thread and the iteration.
+            m_logger.log(MESSAGES[i % 3], threadNum * PARAMS_PER_THREAD + i);
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&InMemoryLoggerTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        // The columns must match the log, event for event.
+        bool ok = true;
+        InMemoryLogger::EventColumns columns = m_logger.exportColumns(4);
+        size_t total = (size_t) threadCount * iterationCount;
+        if (columns.tids.size() != total || columns.msgs.size() != total || columns.params.size() != total)
+            return false;
+        size_t n = 0;
+        for (const auto& evt : m_logger)
+        {
+            if (n >= total || evt.tid != columns.tids[n] || evt.msg != columns.msgs[n] || evt.param != columns.params[n])
+                ok = false;
+            n++;
+        }
+        if (n != total)
+            ok = false;
+
+        // Count events per thread, one page per task.
+        typedef std::map<std::thread::id, int> Counts;
+        Counts counts = m_logger.processPages(Counts(),
+            [](const InMemoryLogger::Event* events, int count)
+            {
+                Counts pageCounts;
+                for (int i = 0; i < count; i++)
+                    pageCounts[events[i].tid]++;
+                return pageCounts;
+            },
+            [](Counts& total, const Counts& pageCounts)
+            {
+                for (const auto& pair : pageCounts)
+                    total[pair.first] += pair.second;
+            }, 4);
+        if ((int) counts.size() != threadCount)
+            ok = false;
+        for (const auto& pair : counts)
+        {
+            if (pair.second != iterationCount)
+                ok = false;
+        }
+        return ok;
+    }
+};
+
+const char* const InMemoryLoggerTester::MESSAGES[3] = { "lock", "unlock", "wait" };
+
+bool testInMemoryLogger()
+{
+    InMemoryLoggerTester tester;
+    return tester.test(4, 100000);
+}
@@ -0,0 +1,150 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include "keyedlocktable.h"
+#include "rwlock.h"
+
+
+//---------------------------------------------------------
+// KeyedLockTableTester
+// Accounts are split into groups whose total balance never changes.
+// Writers transfer between two accounts of a group while write-locking both keys;
+// readers read-lock every key in a group and check its total. A tiny stripe count
+// forces unrelated keys to share locks, and multi-key locking would deadlock
+// without a canonical order.
+//---------------------------------------------------------
+class KeyedLockTableTester
+{
+private:
+    static const int GROUP_SIZE = 4;
+    static const int INITIAL_BALANCE = 100;
+    std::vector<int> m_balances;
+    std::vector<int> m_transfersPerGroup;
+    KeyedLockTable<NonRecursiveRWLock> m_accountLocks;
+    KeyedLockTable<NonRecursiveBenaphore> m_groupLocks;
+    int m_numGroups;
+    int m_iterationCount;
+    std::atomic<bool> m_success;
+    std::atomic<int> m_totalTransfers;
+
+public:
+    KeyedLockTableTester()
+    : m_accountLocks(8, 2)
+    , m_groupLocks(4)
+    , m_numGroups(0)
+    , m_iterationCount(0)
+    , m_success(false)
+    , m_totalTransfers(0)
+    {
+        m_accountLocks.addHotKey(0);
+        m_accountLocks.addHotKey(1);
+    }
+
+    void threadFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+        int transfers = 0;
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            int group = std::uniform_int_distribution<>(0, m_numGroups - 1)(randomEngine);
+            uint64_t keys[GROUP_SIZE];
+            for (int j = 0; j < GROUP_SIZE; j++)
+                keys[j] = group * GROUP_SIZE + j;
+
+            // Choose randomly whether to read or write.
+            if (std::uniform_int_distribution<>(0, 1)(randomEngine) == 0)
+            {
+                // Transfer between two accounts, listed in random order.
+                std::shuffle(keys, keys + GROUP_SIZE, randomEngine);
+                int amount = std::uniform_int_distribution<>(0, 10)(randomEngine);
+                {
+                    MultiKeyWriteLockGuard<NonRecursiveRWLock> guard(m_accountLocks, keys, 2);
+                    m_balances[keys[0]] -= amount;
+                    m_balances[keys[1]] += amount;
+                }
+                uint64_t groupKey = group;
+                MultiKeyLockGuard<NonRecursiveBenaphore> guard(m_groupLocks, &groupKey, 1);
+                m_transfersPerGroup[group]++;
+                transfers++;
+            }
+            else
+            {
+                // Check the group's total.
+                MultiKeyReadLockGuard<NonRecursiveRWLock> guard(m_accountLocks, keys, GROUP_SIZE);
+                int total = 0;
+                for (int j = 0; j < GROUP_SIZE; j++)
+                    total += m_balances[keys[j]];
+                if (total != GROUP_SIZE * INITIAL_BALANCE)
+                    m_success.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        m_totalTransfers.fetch_add(transfers, std::memory_order_relaxed);
+    }
+
+    bool test(int threadCount, int numGroups, int iterationCount)
+    {
+        m_numGroups = numGroups;
+        m_iterationCount = iterationCount;
+        m_balances.assign(numGroups * GROUP_SIZE, INITIAL_BALANCE);
+        m_transfersPerGroup.assign(numGroups, 0);
+        m_success.store(true, std::memory_order_relaxed);
+        m_totalTransfers.store(0, std::memory_order_relaxed);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&KeyedLockTableTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        int totalTransfers = 0;
+        for (int n : m_transfersPerGroup)
+            totalTransfers += n;
+        return m_success.load(std::memory_order_relaxed)
+            && totalTransfers == m_totalTransfers.load(std::memory_order_relaxed);
+    }
+};
+
+const int KeyedLockTableTester::INITIAL_BALANCE;
+
+// Locks more keys than fit in the guard's inline buffer, and checks that every lock is
+// held while the guard lives and released afterwards.
+static bool testLongKeyList()
+{
+    static const int KEY_COUNT = 40;
+    KeyedLockTable<NonRecursiveBenaphore> table(64);
+    uint64_t keys[KEY_COUNT];
+    for (int i = 0; i < KEY_COUNT; i++)
+        keys[i] = KEY_COUNT - 1 - i;
+    {
+        MultiKeyLockGuard<NonRecursiveBenaphore> guard(table, keys, KEY_COUNT);
+        for (int i = 0; i < KEY_COUNT; i++)
+        {
+            if (table.lockFor(keys[i]).tryLock())
+                return false;
+        }
+    }
+    for (int i = 0; i < KEY_COUNT; i++)
+    {
+        NonRecursiveBenaphore& lock = table.lockFor(keys[i]);
+        if (!lock.tryLock())
+            return false;
+        lock.unlock();
+    }
+    return true;
+}
+
+bool testKeyedLockTable()
+{
+    if (!testLongKeyList())
+        return false;
+    KeyedLockTableTester tester;
+    return tester.test(4, 16, 100000);
+}
@@ -0,0 +1,99 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+#include <unordered_map>
+#include "leftright.h"
+
+
+//---------------------------------------------------------
+// LeftRightTester
+// Same check as RWLockTester, on a std::unordered_map: writers store an incrementing sequence
+// of numbers under keys 0 to MAP_SIZE - 1, and readers check that the sequence is intact.
+//---------------------------------------------------------
+class LeftRightTester
+{
+private:
+    static const int MAP_SIZE = 8;
+    typedef std::unordered_map<int, int> Map;
+
+    LeftRight<Map> m_map;
+    int m_iterationCount;
+    std::atomic<bool> m_success;
+
+public:
+    LeftRightTester()
+    : m_iterationCount(0)
+    , m_success(false)
+    {}
+
+    void threadFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            // Choose randomly whether to read or write.
+            if (std::uniform_int_distribution<>(0, 15)(randomEngine) == 0)
+            {
+                int value = std::uniform_int_distribution<>(0, 1000000)(randomEngine);
+                // Erase and reinsert, to exercise rehashing, not just overwriting.
+                m_map.write([value](Map& map)
+                {
+                    map.clear();
+                    for (int k = 0; k < MAP_SIZE; k++)
+                        map[k] = value + k;
+                });
+            }
+            else
+            {
+                bool ok = m_map.read([](const Map& map) -> bool
+                {
+                    if (map.size() != MAP_SIZE)
+                        return false;
+                    int first = map.find(0)->second;
+                    for (int k = 1; k < MAP_SIZE; k++)
+                    {
+                        Map::const_iterator iter = map.find(k);
+                        if (iter == map.end() || iter->second != first + k)
+                            return false;
+                    }
+                    return true;
+                });
+                if (!ok)
+                    m_success.store(false, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+        m_map.write([](Map& map)
+        {
+            for (int k = 0; k < MAP_SIZE; k++)
+                map[k] = k;
+        });
+        m_success.store(true, std::memory_order_relaxed);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&LeftRightTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        return m_success.load(std::memory_order_relaxed);
+    }
+};
+
+bool testLeftRight()
+{
+    LeftRightTester tester;
+    return tester.test(4, 200000);
+}
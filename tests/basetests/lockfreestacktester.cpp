@@ -0,0 +1,106 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <set>
+#include "lockfreestack.h"
+
+
+//---------------------------------------------------------
+// LockFreeStackTester
+// Threads pop a random number of objects from a shared FreeList, claim them,
+// then push them back. If two threads ever pop the same object at once, or an
+// object goes missing, the test fails.
+//---------------------------------------------------------
+class LockFreeStackTester
+{
+private:
+    struct Item : LockFreeStack::Node
+    {
+        std::atomic<int> owner;
+
+        Item() : owner(-1) {}
+    };
+
+    FreeList<Item> m_freeList;
+    int m_iterationCount;
+    std::atomic<bool> m_success;
+
+public:
+    LockFreeStackTester()
+    : m_iterationCount(0)
+    , m_success(false)
+    {}
+
+    void threadFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+        std::vector<Item*> held;
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            int count = std::uniform_int_distribution<>(1, 4)(randomEngine);
+            for (int j = 0; j < count; j++)
+            {
+                Item* item = m_freeList.pop();
+                if (!item)
+                    break;
+                // Claim the item. Nobody else should own it.
+                if (item->owner.exchange(threadNum, std::memory_order_relaxed) != -1)
+                    m_success.store(false, std::memory_order_relaxed);
+                held.push_back(item);
+            }
+            for (Item* item : held)
+            {
+                if (item->owner.exchange(-1, std::memory_order_relaxed) != threadNum)
+                    m_success.store(false, std::memory_order_relaxed);
+                m_freeList.push(item);
+            }
+            held.clear();
+        }
+    }
+
+    bool test(int threadCount, int itemCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+        m_success.store(true, std::memory_order_relaxed);
+        std::set<Item*> allItems;
+        for (int i = 0; i < itemCount; i++)
+        {
+            Item* item = new Item;
+            allItems.insert(item);
+            m_freeList.push(item);
+        }
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&LockFreeStackTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        // Every item must be back in the list exactly once.
+        std::vector<Item*> popped;
+        while (Item* item = m_freeList.pop())
+        {
+            if (allItems.erase(item) != 1)
+                m_success.store(false, std::memory_order_relaxed);
+            popped.push_back(item);
+        }
+        if (!allItems.empty())
+            m_success.store(false, std::memory_order_relaxed);
+        for (Item* item : popped)
+            m_freeList.push(item);
+        return m_success.load(std::memory_order_relaxed);
+    }
+};
+
+bool testLockFreeStack()
+{
+    LockFreeStackTester tester;
+    return tester.test(4, 8, 400000);
+}
@@ -17,21 +17,67 @@ struct TestInfo
 };
 
 bool testBenaphore();
+bool testBenaphorePolicies();
+bool testGroupCommit();
 bool testRecursiveBenaphore();
+bool testOwnerAwareSpin();
+bool testOwnerAwareRecursiveBenaphore();
+bool testPriorityInheritanceLock();
 bool testAutoResetEvent();
+bool testPollableSemaphore();
+bool testUringWait();
+bool testCoalescedWake();
+bool testCascadingWake();
 bool testRWLock();
 bool testRWLockSimple();
+bool testReadMostlyRWLock();
+bool testLeftRight();
+bool testOptimisticRWLock();
+bool testRWSemaphore();
+bool testAtomicSharedPtr();
+bool testSynchronized();
+bool testKeyedLockTable();
+bool testLockFreeStack();
+bool testMPSCQueue();
+bool testEventLoop();
 bool testDiningPhilosophers();
+bool testInMemoryLogger();
+bool testCompactLogger();
+bool testShardedLogger();
+bool testTraceScope();
 
 #define ADD_TEST(name) { #name, name },
 TestInfo g_tests[] =
 {
     ADD_TEST(testBenaphore)
+    ADD_TEST(testBenaphorePolicies)
+    ADD_TEST(testGroupCommit)
     ADD_TEST(testRecursiveBenaphore)
+    ADD_TEST(testOwnerAwareSpin)
+    ADD_TEST(testOwnerAwareRecursiveBenaphore)
+    ADD_TEST(testPriorityInheritanceLock)
     ADD_TEST(testAutoResetEvent)
+    ADD_TEST(testPollableSemaphore)
+    ADD_TEST(testUringWait)
+    ADD_TEST(testCoalescedWake)
+    ADD_TEST(testCascadingWake)
     ADD_TEST(testRWLock)
     ADD_TEST(testRWLockSimple)
+    ADD_TEST(testReadMostlyRWLock)
+    ADD_TEST(testLeftRight)
+    ADD_TEST(testOptimisticRWLock)
+    ADD_TEST(testRWSemaphore)
+    ADD_TEST(testAtomicSharedPtr)
+    ADD_TEST(testSynchronized)
+    ADD_TEST(testKeyedLockTable)
+    ADD_TEST(testLockFreeStack)
+    ADD_TEST(testMPSCQueue)
+    ADD_TEST(testEventLoop)
     ADD_TEST(testDiningPhilosophers)
+    ADD_TEST(testInMemoryLogger)
+    ADD_TEST(testCompactLogger)
+    ADD_TEST(testShardedLogger)
+    ADD_TEST(testTraceScope)
 };
 
 //---------------------------------------------------------
@@ -0,0 +1,85 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <memory>
+#include "mpscqueue.h"
+
+
+//---------------------------------------------------------
+// MPSCQueueTester
+// Several producers push numbered items while one consumer pops them with the
+// blocking pop(). Each producer's items must arrive exactly once and in order.
+// Producers pause at random so that the consumer often has to park.
+//---------------------------------------------------------
+class MPSCQueueTester
+{
+private:
+    struct Item : MPSCQueue::Node
+    {
+        int producer;
+        int sequence;
+    };
+
+    BlockingMPSCQueue m_queue;
+    std::unique_ptr<Item[]> m_items;
+    int m_iterationCount;
+
+public:
+    MPSCQueueTester() : m_iterationCount(0) {}
+
+    void producerFunc(int producer)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            Item& item = m_items[producer * m_iterationCount + i];
+            item.producer = producer;
+            item.sequence = i;
+            m_queue.push(&item);
+
+            // Occasionally yield, so the consumer sometimes runs dry and parks.
+            if (std::uniform_int_distribution<>(0, 100)(randomEngine) == 0)
+                std::this_thread::yield();
+        }
+    }
+
+    bool test(int producerCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+        m_items = std::unique_ptr<Item[]>(new Item[producerCount * iterationCount]);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < producerCount; i++)
+            threads.emplace_back(&MPSCQueueTester::producerFunc, this, i);
+
+        // Consume on this thread.
+        bool ok = true;
+        std::vector<int> nextSequence(producerCount);
+        for (int n = 0; n < producerCount * iterationCount; n++)
+        {
+            Item* item = static_cast<Item*>(m_queue.pop());
+            if (item->sequence != nextSequence[item->producer])
+                ok = false;
+            nextSequence[item->producer] = item->sequence + 1;
+        }
+        if (m_queue.tryPop() != nullptr)
+            ok = false;
+
+        for (std::thread& t : threads)
+            t.join();
+        return ok;
+    }
+};
+
+bool testMPSCQueue()
+{
+    MPSCQueueTester tester;
+    return tester.test(3, 400000);
+}
@@ -0,0 +1,94 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <random>
+#include "rwlock.h"
+
+
+//---------------------------------------------------------
+// OptimisticRWLockTester
+// Like RWLockTester, but readers use optimisticRead, and the shared array
+// is accessed through relaxed atomics since optimistic readers race with writers.
+//---------------------------------------------------------
+class OptimisticRWLockTester
+{
+private:
+    static const int SHARED_ARRAY_LENGTH = 8;
+    std::atomic<int> m_shared[SHARED_ARRAY_LENGTH];
+    NonRecursiveRWLock m_rwLock;
+    int m_iterationCount;
+    std::atomic<bool> m_success;
+
+public:
+    OptimisticRWLockTester()
+    : m_iterationCount(0)
+    , m_success(false)
+    {}
+
+    void threadFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            // Choose randomly whether to read or write.
+            if (std::uniform_int_distribution<>(0, 3)(randomEngine) == 0)
+            {
+                // Write an incrementing sequence of numbers (backwards).
+                int value = std::uniform_int_distribution<>()(randomEngine);
+                WriteLockGuard<NonRecursiveRWLock> guard(m_rwLock);
+                for (int j = SHARED_ARRAY_LENGTH - 1; j >= 0; j--)
+                {
+                    m_shared[j].store(value--, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                // Copy the array, then check that the sequence of numbers is incrementing.
+                int copy[SHARED_ARRAY_LENGTH];
+                optimisticRead(m_rwLock, [&]() {
+                    for (int j = 0; j < SHARED_ARRAY_LENGTH; j++)
+                        copy[j] = m_shared[j].load(std::memory_order_relaxed);
+                });
+                bool ok = true;
+                int value = copy[0];
+                for (int j = 1; j < SHARED_ARRAY_LENGTH; j++)
+                {
+                    ok = ok && (++value == copy[j]);
+                }
+                if (!ok)
+                {
+                    m_success.store(false, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+        for (int j = 0; j < SHARED_ARRAY_LENGTH; j++)
+            m_shared[j].store(j, std::memory_order_relaxed);
+        m_success.store(true, std::memory_order_relaxed);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&OptimisticRWLockTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        return m_success.load(std::memory_order_relaxed);
+    }
+};
+
+bool testOptimisticRWLock()
+{
+    OptimisticRWLockTester tester;
+    return tester.test(4, 1000000);
+}
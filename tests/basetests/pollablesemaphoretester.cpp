@@ -0,0 +1,144 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "sema.h"
+#include "autoresetevent.h"
+
+#if defined(__linux__)
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+#include <poll.h>
+
+
+//---------------------------------------------------------
+// PollableSemaphoreTester
+// Producers signal a PollableSemaphore, and each one signals a PollableAutoResetEvent once
+// it's done. A single consumer waits on both in the same poll() call, as an event loop
+// would. The consumer must take exactly as many units as were signaled, and notice
+// when every producer is done.
+//---------------------------------------------------------
+class PollableSemaphoreTester
+{
+private:
+    PollableSemaphore m_sema;
+    PollableAutoResetEvent m_doneEvent;
+    std::atomic<int> m_doneCount;
+    int m_iterationCount;
+
+public:
+    PollableSemaphoreTester() : m_doneCount(0), m_iterationCount(0) {}
+
+    void producerFunc(int producer)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            m_sema.signal();
+            if (std::uniform_int_distribution<>(0, 20)(randomEngine) == 0)
+                std::this_thread::yield();
+        }
+        m_doneCount.fetch_add(1, std::memory_order_release);
+        m_doneEvent.signal();
+    }
+
+    bool test(int producerCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+
+        // Cancelling a wait that nobody signaled must restore the count.
+        if (m_sema.beginPollableWait() || m_sema.cancelPollableWait())
+            return false;
+        m_sema.signal();
+        if (!m_sema.tryWait())
+            return false;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < producerCount; i++)
+            threads.emplace_back(&PollableSemaphoreTester::producerFunc, this, i);
+
+        int total = producerCount * iterationCount;
+        int taken = 0;
+        bool semaRegistered = false;
+        bool eventRegistered = false;
+        bool allDone = false;
+        while (taken < total || !allDone)
+        {
+            if (taken < total && !semaRegistered)
+            {
+                if (m_sema.beginPollableWait())
+                {
+                    taken++;
+                    continue;
+                }
+                semaRegistered = true;
+            }
+            if (!allDone && !eventRegistered)
+            {
+                if (m_doneEvent.beginPollableWait())
+                {
+                    allDone = (m_doneCount.load(std::memory_order_acquire) == producerCount);
+                    continue;
+                }
+                eventRegistered = true;
+            }
+
+            struct pollfd pfds[2];
+            int numFds = 0;
+            if (semaRegistered)
+            {
+                pfds[numFds].fd = m_sema.fd();
+                pfds[numFds++].events = POLLIN;
+            }
+            if (eventRegistered)
+            {
+                pfds[numFds].fd = m_doneEvent.fd();
+                pfds[numFds++].events = POLLIN;
+            }
+            if (poll(pfds, numFds, -1) <= 0)
+                continue;
+            for (int i = 0; i < numFds; i++)
+            {
+                if ((pfds[i].revents & POLLIN) == 0)
+                    continue;
+                if (pfds[i].fd == m_sema.fd() && m_sema.finishPollableWait())
+                {
+                    taken++;
+                    semaRegistered = false;
+                }
+                if (pfds[i].fd == m_doneEvent.fd() && m_doneEvent.finishPollableWait())
+                {
+                    allDone = (m_doneCount.load(std::memory_order_acquire) == producerCount);
+                    eventRegistered = false;
+                }
+            }
+        }
+        // The loop only exits once the event wait has been consumed, so nothing's left registered.
+        bool ok = !semaRegistered && !eventRegistered;
+
+        for (std::thread& t : threads)
+            t.join();
+        return ok && !m_sema.tryWait();
+    }
+};
+
+bool testPollableSemaphore()
+{
+    PollableSemaphoreTester tester;
+    return tester.test(3, 100000);
+}
+
+#else
+
+bool testPollableSemaphore()
+{
+    return true;    // eventfd is Linux-only.
+}
+
+#endif
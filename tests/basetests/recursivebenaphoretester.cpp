@@ -13,6 +13,7 @@
 //---------------------------------------------------------
 // RecursiveBenaphoreTester
 //---------------------------------------------------------
+template <class LockType>
 class RecursiveBenaphoreTester
 {
 private:
@@ -21,12 +22,14 @@ private:
         int iterations;
         int workUnitsComplete;
         int amountIncremented;
+        int lockCalls;
 
         ThreadStats()
         {
             iterations = 0;
             workUnitsComplete = 0;
             amountIncremented = 0;
+            lockCalls = 0;
         }
 
         ThreadStats& operator+=(const ThreadStats &other)
@@ -34,17 +37,30 @@ private:
             iterations += other.iterations;
             workUnitsComplete += other.workUnitsComplete;
             amountIncremented += other.amountIncremented;
+            lockCalls += other.lockCalls;
             return *this;
         }
     };
 
     int m_iterationCount;
-    RecursiveBenaphore m_recursiveMutex;
+    LockType m_recursiveMutex;
     int m_value;
     std::vector<ThreadStats> m_threadStats;
+    int m_lockCalls;
 
 public:
-    RecursiveBenaphoreTester() : m_iterationCount(0), m_value(0) {}
+    RecursiveBenaphoreTester() : m_iterationCount(0), m_value(0), m_lockCalls(0) {}
+
+    const LockType& lock() const
+    {
+        return m_recursiveMutex;
+    }
+
+    // Number of calls to lock() made by the last test, not counting tryLock().
+    int lockCalls() const
+    {
+        return m_lockCalls;
+    }
 
     void threadFunc(int threadNum)
     {
@@ -93,6 +109,7 @@ public:
                 else
                 {
                     m_recursiveMutex.lock();
+                    localStats.lockCalls++;
                 }
                 lockCount++;
             }
@@ -133,12 +150,23 @@ public:
         ThreadStats totalStats;
         for (const ThreadStats& s : m_threadStats)
             totalStats += s;
+        m_lockCalls = totalStats.lockCalls;
         return (m_value == totalStats.amountIncremented);
     }
 };
 
 bool testRecursiveBenaphore()
 {
-    RecursiveBenaphoreTester tester;
+    RecursiveBenaphoreTester<RecursiveBenaphore> tester;
     return tester.test(4, 100000);
 }
+
+bool testOwnerAwareRecursiveBenaphore()
+{
+    // Counted, so that re-entry by the owner must show up in the stats like any other lock().
+    RecursiveBenaphoreTester<BasicRecursiveBenaphore<BasicLightweightSemaphore<Semaphore, NoSpin>, ContentionStats, NoAlignment, OwnerAwareSpin<>>> tester;
+    if (!tester.test(4, 100000))
+        return false;
+    const ContentionStats& stats = tester.lock().stats();
+    return stats.uncontended() + stats.spinSuccesses() + stats.kernelWaits() == (uint64_t) tester.lockCalls();
+}
@@ -8,17 +8,19 @@
 #include <string>
 #include <thread>
 #include "rwlock.h"
+#include "readmostlyrwlock.h"
 
 
 //---------------------------------------------------------
 // RWLockTester
 //---------------------------------------------------------
+template <class LockType>
 class RWLockTester
 {
 private:
     static const int SHARED_ARRAY_LENGTH = 8;
     int m_shared[SHARED_ARRAY_LENGTH];
-    NonRecursiveRWLock m_rwLock;
+    LockType m_rwLock;
     int m_iterationCount;
     std::atomic<bool> m_success;
 
@@ -40,7 +42,7 @@ public:
             {
                 // Write an incrementing sequence of numbers (backwards).
                 int value = std::uniform_int_distribution<>()(randomEngine);
-                WriteLockGuard<NonRecursiveRWLock> guard(m_rwLock);
+                WriteLockGuard<LockType> guard(m_rwLock);
                 for (int j = SHARED_ARRAY_LENGTH - 1; j >= 0; j--)
                 {
                     m_shared[j] = value--;
@@ -51,7 +53,7 @@ public:
                 // Check that the sequence of numbers is incrementing.
                 bool ok = true;
                 {
-                    ReadLockGuard<NonRecursiveRWLock> guard(m_rwLock);
+                    ReadLockGuard<LockType> guard(m_rwLock);
                     int value = m_shared[0];
                     for (int j = 1; j < SHARED_ARRAY_LENGTH; j++)
                     {
@@ -85,6 +87,28 @@ public:
 
 bool testRWLock()
 {
-    RWLockTester tester;
+    RWLockTester<NonRecursiveRWLock> tester;
     return tester.test(4, 1000000);
 }
+
+bool testReadMostlyRWLock()
+{
+    // Reader slots must be recycled as threads exit: more threads than there are slots,
+    // one after another, must all get the fast path.
+    ReadMostlyRWLock lock;
+    for (int i = 0; i < 100; i++)
+    {
+        bool fast = false;
+        std::thread t([&]()
+        {
+            fast = ReadMostlyRWLock::hasReaderSlot();
+            ReadLockGuard<ReadMostlyRWLock> guard(lock);
+        });
+        t.join();
+        if (!fast)
+            return false;
+    }
+
+    RWLockTester<ReadMostlyRWLock> tester;
+    return tester.test(4, 200000);
+}
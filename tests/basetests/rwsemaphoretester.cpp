@@ -0,0 +1,103 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+#include "rwsemaphore.h"
+
+
+//---------------------------------------------------------
+// RWSemaphoreTester
+// Threads randomly take batches of permits, exclusive access, or either one with a
+// short timeout. Each holder adds its permits to m_inUse, which must never exceed the
+// total, and an exclusive holder must see nobody else inside.
+//---------------------------------------------------------
+class RWSemaphoreTester
+{
+private:
+    static const int MAX_PERMITS = 4;
+
+    RWSemaphore m_sema;
+    std::atomic<int> m_inUse;
+    std::atomic<bool> m_success;
+    int m_iterationCount;
+
+public:
+    RWSemaphoreTester() : m_sema(MAX_PERMITS), m_inUse(0), m_success(false), m_iterationCount(0) {}
+
+    void enter(int count)
+    {
+        int inUse = m_inUse.fetch_add(count, std::memory_order_relaxed) + count;
+        if (inUse > MAX_PERMITS)
+            m_success.store(false, std::memory_order_relaxed);
+    }
+
+    void exit(int count)
+    {
+        m_inUse.fetch_sub(count, std::memory_order_relaxed);
+    }
+
+    void threadFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            int r = std::uniform_int_distribution<>(0, 99)(randomEngine);
+            int count;
+            if (r < 10)
+                count = MAX_PERMITS;    // Exclusive
+            else
+                count = std::uniform_int_distribution<>(1, 2)(randomEngine);
+
+            if (threadNum == 0 || r % 3 != 0)
+            {
+                m_sema.acquire(count);
+            }
+            else
+            {
+                uint64_t usecs = std::uniform_int_distribution<>(0, 50)(randomEngine);
+                if (!m_sema.timedAcquire(count, usecs))
+                    continue;
+            }
+            enter(count);
+            // Hold the permits for a little while.
+            int spin = std::uniform_int_distribution<>(0, 200)(randomEngine);
+            for (int j = 0; j < spin; j++)
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            exit(count);
+            m_sema.release(count);
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+        m_success.store(true, std::memory_order_relaxed);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&RWSemaphoreTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        // Every permit must have come back.
+        if (!m_sema.tryAcquire(MAX_PERMITS))
+            return false;
+        m_sema.release(MAX_PERMITS);
+        return m_success.load(std::memory_order_relaxed);
+    }
+};
+
+const int RWSemaphoreTester::MAX_PERMITS;
+
+bool testRWSemaphore()
+{
+    RWSemaphoreTester tester;
+    return tester.test(4, 30000);
+}
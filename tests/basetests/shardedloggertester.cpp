@@ -0,0 +1,108 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <map>
+#include "shardedinmemorylogger.h"
+
+
+//---------------------------------------------------------
+// ShardedLoggerTester
+// Logs a deterministic sequence of events from each thread, spread over several shards
+// per node so that the merge is exercised even on single-node machines, then checks that
+// the merged log contains every event exactly once and each thread's events in order.
+//---------------------------------------------------------
+class ShardedLoggerTester
+{
+private:
+    static const size_t PARAMS_PER_THREAD = 1000000;
+    ShardedInMemoryLogger m_logger;
+    int m_iterationCount;
+
+public:
+    ShardedLoggerTester(int shardsPerNode) : m_logger(shardsPerNode), m_iterationCount(0) {}
+
+    void threadFunc(int threadNum)
+    {
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            // The param identifies both the thread and the iteration.
+            m_logger.log("event", threadNum * PARAMS_PER_THREAD + i);
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&ShardedLoggerTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        // Replay event log to make sure it's OK.
+        bool ok = true;
+        std::vector<int> nextIteration(threadCount);
+        std::vector<uint64_t> lastTimestamp(threadCount);
+        std::map<std::thread::id, int> threadNums;
+        size_t numEvents = 0;
+        for (const auto& evt : m_logger)
+        {
+            int threadNum = int(evt.param / PARAMS_PER_THREAD);
+            int i = int(evt.param % PARAMS_PER_THREAD);
+            if (threadNum >= threadCount || i != nextIteration[threadNum])
+            {
+                ok = false;
+                continue;
+            }
+            nextIteration[threadNum]++;
+            auto inserted = threadNums.insert(std::make_pair(evt.tid, threadNum));
+            if (inserted.first->second != threadNum)
+                ok = false;
+            if (evt.timestamp < lastTimestamp[threadNum])
+                ok = false;
+            lastTimestamp[threadNum] = evt.timestamp;
+            numEvents++;
+        }
+        for (int n : nextIteration)
+        {
+            if (n != iterationCount)
+                ok = false;
+        }
+        if (numEvents != m_logger.eventCount())
+            ok = false;
+        return ok;
+    }
+};
+
+// A thread that alternates between two loggers must keep logging to the same shard of each.
+static bool testShardedLoggerAlternating()
+{
+    ShardedInMemoryLogger a(4);
+    ShardedInMemoryLogger b(4);
+    bool ok = true;
+    std::thread t([&]()
+    {
+        int shardA = a.currentShardIndex();
+        int shardB = b.currentShardIndex();
+        for (int i = 0; i < 1000; i++)
+        {
+            a.log("a", i);
+            b.log("b", i);
+            if (a.currentShardIndex() != shardA || b.currentShardIndex() != shardB)
+                ok = false;
+        }
+    });
+    t.join();
+    return ok && a.eventCount() == 1000 && b.eventCount() == 1000;
+}
+
+bool testShardedLogger()
+{
+    ShardedLoggerTester tester(4);
+    return tester.test(8, 100000) && testShardedLoggerAlternating();
+}
@@ -0,0 +1,116 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <type_traits>
+#include "synchronized.h"
+
+
+// The forwarding constructors must not act as implicit conversions or stand in for the
+// deleted copy constructor.
+typedef Synchronized<std::vector<int>> SyncList;
+static_assert(!std::is_convertible<std::vector<int>, SyncList>::value, "Synchronized converts implicitly");
+static_assert(!std::is_constructible<SyncList, SyncList&>::value, "Synchronized copies from a non-const lvalue");
+static_assert(!std::is_constructible<RWSynchronized<int>, RWSynchronized<int>&>::value, "RWSynchronized copies from a non-const lvalue");
+static_assert(std::is_constructible<SyncList, size_t, int>::value, "Synchronized doesn't forward its arguments");
+
+
+//---------------------------------------------------------
+// SynchronizedTester
+// Threads append to a shared vector and update a shared array through
+// Synchronized and RWSynchronized guards.
+//---------------------------------------------------------
+class SynchronizedTester
+{
+private:
+    static const int SHARED_ARRAY_LENGTH = 8;
+    struct SharedArray
+    {
+        int values[SHARED_ARRAY_LENGTH];
+
+        SharedArray()
+        {
+            for (int j = 0; j < SHARED_ARRAY_LENGTH; j++)
+                values[j] = j;
+        }
+    };
+
+    Synchronized<std::vector<int>> m_list;
+    RWSynchronized<SharedArray> m_array;
+    int m_iterationCount;
+    std::atomic<bool> m_success;
+
+public:
+    SynchronizedTester()
+    : m_iterationCount(0)
+    , m_success(false)
+    {}
+
+    void threadFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            m_list.lock()->push_back(threadNum);
+
+            // Choose randomly whether to read or write.
+            if (std::uniform_int_distribution<>(0, 3)(randomEngine) == 0)
+            {
+                // Write an incrementing sequence of numbers (backwards).
+                int value = std::uniform_int_distribution<>()(randomEngine);
+                RWSynchronized<SharedArray>::WriteGuard guard = m_array.write();
+                for (int j = SHARED_ARRAY_LENGTH - 1; j >= 0; j--)
+                    guard->values[j] = value--;
+            }
+            else
+            {
+                // Check that the sequence of numbers is incrementing.
+                RWSynchronized<SharedArray>::ReadGuard guard = m_array.read();
+                int value = guard->values[0];
+                for (int j = 1; j < SHARED_ARRAY_LENGTH; j++)
+                {
+                    if (++value != guard->values[j])
+                        m_success.store(false, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+        m_success.store(true, std::memory_order_relaxed);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&SynchronizedTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        // Every thread must have appended exactly iterationCount times.
+        Synchronized<std::vector<int>>::Guard list = m_list.tryLock();
+        if (!list || list->size() != size_t(threadCount * iterationCount))
+            return false;
+        std::vector<int> counts(threadCount);
+        for (int threadNum : *list)
+            counts[threadNum]++;
+        for (int count : counts)
+        {
+            if (count != iterationCount)
+                return false;
+        }
+        return m_success.load(std::memory_order_relaxed);
+    }
+};
+
+bool testSynchronized()
+{
+    SynchronizedTester tester;
+    return tester.test(4, 200000);
+}
@@ -0,0 +1,95 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include "tracescope.h"
+
+
+//---------------------------------------------------------
+// TraceScopeTester
+// Each thread runs nested scopes a known number of times, interleaved with
+// ordinary log events, then the aggregated stats are checked for consistency.
+// A scope on a second logger, nested inside those, must still be at depth 0 there.
+//---------------------------------------------------------
+class TraceScopeTester
+{
+private:
+    InMemoryLogger m_logger;
+    InMemoryLogger m_otherLogger;
+    int m_iterationCount;
+
+    static const char* const OUTER;
+    static const char* const INNER;
+    static const char* const OTHER;
+
+public:
+    TraceScopeTester() : m_iterationCount(0) {}
+
+    void threadFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++)
+        {
+            TraceScope outer(m_logger, OUTER);
+            m_logger.log("work", threadNum);
+            for (int j = 0; j < 2; j++)
+            {
+                TraceScope inner(m_logger, INNER);
+                TraceScope other(m_otherLogger, OTHER);
+                // Do a random amount of work.
+                int workUnits = std::uniform_int_distribution<int>(0, 100)(randomEngine);
+                for (int k = 0; k < workUnits; k++)
+                    randomEngine();
+            }
+        }
+    }
+
+    bool test(int threadCount, int iterationCount)
+    {
+        m_iterationCount = iterationCount;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&TraceScopeTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        std::vector<TraceScopeStats> stats = aggregateTraceScopes(m_logger);
+        if (stats.size() != 2 || stats[0].name != OUTER || stats[1].name != INNER)
+            return false;
+        const TraceScopeStats& outer = stats[0];
+        const TraceScopeStats& inner = stats[1];
+        bool ok = true;
+        ok = ok && (outer.calls == size_t(threadCount * iterationCount));
+        ok = ok && (inner.calls == size_t(2 * threadCount * iterationCount));
+        ok = ok && (inner.exclusiveNanos == inner.inclusiveNanos);
+        ok = ok && (outer.inclusiveNanos >= inner.inclusiveNanos);
+        ok = ok && (outer.exclusiveNanos <= outer.inclusiveNanos - inner.inclusiveNanos);
+
+        for (const auto& evt : m_otherLogger)
+        {
+            TraceScope::TraceParam param = evt.param;
+            if (!param.isEnd && param.depth != 0)
+                ok = false;
+        }
+        std::vector<TraceScopeStats> otherStats = aggregateTraceScopes(m_otherLogger);
+        ok = ok && otherStats.size() == 1 && otherStats[0].calls == size_t(2 * threadCount * iterationCount);
+        return ok;
+    }
+};
+
+const char* const TraceScopeTester::OUTER = "outer";
+const char* const TraceScopeTester::INNER = "inner";
+const char* const TraceScopeTester::OTHER = "other";
+
+bool testTraceScope()
+{
+    TraceScopeTester tester;
+    return tester.test(4, 20000);
+}
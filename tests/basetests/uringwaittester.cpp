@@ -0,0 +1,211 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include "uringwait.h"
+
+#if CPP11OM_HAVE_IO_URING
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <chrono>
+#include "autoresetevent.h"
+
+
+//---------------------------------------------------------
+// UringWaitTester
+// A producer signals a semaphore backed by eventfd and another backed by a futex, in random
+// order, while one thread waits on both through the same io_uring. The ring thread must
+// take exactly as many units from each as were signaled.
+// Runs once with IORING_OP_FUTEX_WAIT, if the kernel has it, and once with the helper thread.
+// testCancel() abandons waits, both after they've been signaled and while nothing is, and
+// checks that the next wait doesn't complete early.
+//---------------------------------------------------------
+class UringWaitTester
+{
+private:
+    PollableSemaphore m_pollable;
+    FutexLightweightSemaphore m_futex;
+    int m_iterationCount;
+
+public:
+    UringWaitTester() : m_iterationCount(0) {}
+
+    void producerFunc()
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        int pollableLeft = m_iterationCount;
+        int futexLeft = m_iterationCount;
+        while (pollableLeft > 0 || futexLeft > 0)
+        {
+            if (futexLeft == 0 || (pollableLeft > 0 && std::uniform_int_distribution<>(0, 1)(randomEngine)))
+            {
+                m_pollable.signal();
+                pollableLeft--;
+            }
+            else
+            {
+                m_futex.signal();
+                futexLeft--;
+            }
+            if (std::uniform_int_distribution<>(0, 20)(randomEngine) == 0)
+                std::this_thread::yield();
+        }
+    }
+
+    // Arms a wait on the ring, unless it succeeds right away. Returns true if an SQE was queued.
+    template <class Waitable>
+    static bool startWait(IoUring& ring, UringWait<Waitable>& wait, uint64_t userData, int& taken)
+    {
+        if (wait.begin())
+        {
+            taken++;
+            return false;
+        }
+        io_uring_sqe* sqe = ring.getSqe();
+        assert(sqe);
+        wait.prepare(sqe, userData);
+        return true;
+    }
+
+    bool test(int iterationCount, bool useFutexOp)
+    {
+        IoUring ring(8);
+        if (!ring.isValid())
+            return true;    // io_uring is unavailable here; nothing to test.
+        useFutexOp = useFutexOp && ring.supportsOp(IoUring::OP_FUTEX_WAIT);
+
+        m_iterationCount = iterationCount;
+        UringWait<PollableSemaphore> pollableWait(m_pollable, useFutexOp);
+        UringWait<FutexLightweightSemaphore> futexWait(m_futex, useFutexOp);
+        std::thread producer(&UringWaitTester::producerFunc, this);
+
+        int pollableTaken = 0;
+        int futexTaken = 0;
+        bool pollableArmed = false;
+        bool futexArmed = false;
+        bool ok = true;
+        while (pollableTaken < iterationCount || futexTaken < iterationCount)
+        {
+            if (!pollableArmed && pollableTaken < iterationCount)
+                pollableArmed = startWait(ring, pollableWait, 1, pollableTaken);
+            if (!futexArmed && futexTaken < iterationCount)
+                futexArmed = startWait(ring, futexWait, 2, futexTaken);
+            if (!pollableArmed && !futexArmed)
+                continue;
+            if (ring.submit(1) < 0)
+            {
+                ok = false;
+                break;
+            }
+            io_uring_cqe cqe;
+            while (ring.popCompletion(cqe))
+            {
+                if (cqe.user_data == 1)
+                {
+                    pollableArmed = false;
+                    if (pollableWait.complete(cqe.res))
+                        pollableTaken++;
+                }
+                else
+                {
+                    futexArmed = false;
+                    if (futexWait.complete(cqe.res))
+                        futexTaken++;
+                }
+            }
+        }
+        producer.join();
+        // Nothing must be left over.
+        return ok && !m_pollable.tryWait() && !m_futex.tryWait();
+    }
+
+    // Cancels the SQE with the given user data, and reaps both completions.
+    static bool cancelSqe(IoUring& ring, uint64_t userData)
+    {
+        io_uring_sqe* sqe = ring.getSqe();
+        assert(sqe);
+        IoUring::prepCancel(sqe, userData, userData + 1);
+        int reaped = 0;
+        while (reaped < 2)
+        {
+            if (ring.submit(1) < 0)
+                return false;
+            io_uring_cqe cqe;
+            while (ring.popCompletion(cqe))
+                reaped++;
+        }
+        return true;
+    }
+
+    bool testCancel(int iterationCount, bool useFutexOp)
+    {
+        IoUring ring(8);
+        if (!ring.isValid())
+            return true;
+        useFutexOp = useFutexOp && ring.supportsOp(IoUring::OP_FUTEX_WAIT);
+        UringWait<FutexLightweightSemaphore> futexWait(m_futex, useFutexOp);
+
+        for (int i = 0; i < iterationCount; i++)
+        {
+            // Abandon a wait. Every other time, signal first and give the wake-up time to
+            // arrive, so that cancel() must take the unit.
+            bool signaled = (i % 2) == 0;
+            io_uring_sqe* sqe = ring.getSqe();
+            if (futexWait.begin() || !sqe)
+                return false;
+            futexWait.prepare(sqe, 1);
+            if (ring.submit() < 0)
+                return false;
+            if (signaled)
+            {
+                m_futex.signal();
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+            if (!cancelSqe(ring, 1))
+                return false;
+            if (futexWait.cancel() != signaled)
+                return false;
+
+            // Nothing is signaled now, so the next wait must not complete.
+            sqe = ring.getSqe();
+            if (futexWait.begin() || !sqe)
+                return false;
+            futexWait.prepare(sqe, 1);
+            if (ring.submit() < 0)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            io_uring_cqe cqe;
+            bool early = ring.popCompletion(cqe);
+            if (!early && !cancelSqe(ring, 1))
+                return false;
+            if (early || futexWait.cancel())
+                return false;
+        }
+        return !m_futex.tryWait();
+    }
+};
+
+bool testUringWait()
+{
+    UringWaitTester futexOpTester;
+    UringWaitTester helperTester;
+    if (!futexOpTester.test(100000, true) || !helperTester.test(100000, false))
+        return false;
+    UringWaitTester futexOpCancelTester;
+    UringWaitTester helperCancelTester;
+    return futexOpCancelTester.testCancel(100, true) && helperCancelTester.testCancel(100, false);
+}
+
+#else
+
+bool testUringWait()
+{
+    return true;    // io_uring is Linux-only.
+}
+
+#endif
@@ -0,0 +1,108 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+#include "sema.h"
+
+
+//---------------------------------------------------------
+// WakePolicyTester
+// Producers signal a semaphore in random bursts while consumers wait on it, without spinning,
+// so that most units pass through the wake policy to sleeping threads. Every unit must
+// be consumed exactly once; a lost wake-up leaves a consumer hanging.
+//---------------------------------------------------------
+template <class SemaType>
+class WakePolicyTester
+{
+private:
+    SemaType m_sema;
+    int m_unitsPerProducer;
+    int m_unitsPerConsumer;
+    std::atomic<int> m_consumed;
+
+public:
+    WakePolicyTester() : m_unitsPerProducer(0), m_unitsPerConsumer(0), m_consumed(0) {}
+
+    void producerFunc(int threadNum)
+    {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+        int remaining = m_unitsPerProducer;
+        while (remaining > 0)
+        {
+            int burst = std::uniform_int_distribution<>(1, 4)(randomEngine);
+            if (burst > remaining)
+                burst = remaining;
+            m_sema.signal(burst);
+            remaining -= burst;
+            if (std::uniform_int_distribution<>(0, 4)(randomEngine) == 0)
+                std::this_thread::yield();
+        }
+    }
+
+    void consumerFunc(int threadNum)
+    {
+        for (int i = 0; i < m_unitsPerConsumer; i++)
+        {
+            m_sema.wait();
+            m_consumed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool test(int producerCount, int consumerCount, int unitsPerConsumer)
+    {
+        int total = consumerCount * unitsPerConsumer;
+        if (total % producerCount != 0)
+            return false;
+        m_unitsPerProducer = total / producerCount;
+        m_unitsPerConsumer = unitsPerConsumer;
+        m_consumed.store(0, std::memory_order_relaxed);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < consumerCount; i++)
+            threads.emplace_back(&WakePolicyTester::consumerFunc, this, i);
+        for (int i = 0; i < producerCount; i++)
+            threads.emplace_back(&WakePolicyTester::producerFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        // Nothing left over, either.
+        return m_consumed.load(std::memory_order_relaxed) == total && !m_sema.tryWait();
+    }
+
+    const SemaType& sema() const
+    {
+        return m_sema;
+    }
+};
+
+#if defined(__linux__)
+typedef FutexSemaphore WakePolicyTestKernelSemaphore;   // signal(n) is a single syscall
+#else
+typedef Semaphore WakePolicyTestKernelSemaphore;
+#endif
+
+bool testCoalescedWake()
+{
+    WakePolicyTester<BasicLightweightSemaphore<WakePolicyTestKernelSemaphore, NoSpin, NoStats, NoAlignment, CoalescedWake>> tester;
+    if (!tester.test(8, 8, 50000))
+        return false;
+
+    // Again with spinning, counting every wait. Each one must be counted exactly once.
+    WakePolicyTester<BasicLightweightSemaphore<WakePolicyTestKernelSemaphore, DefaultSpin, ContentionStats, NoAlignment, CoalescedWake>> countedTester;
+    if (!countedTester.test(8, 8, 10000))
+        return false;
+    const ContentionStats& stats = countedTester.sema().stats();
+    return stats.uncontended() + stats.spinSuccesses() + stats.kernelWaits() == 8 * 10000;
+}
+
+bool testCascadingWake()
+{
+    WakePolicyTester<BasicLightweightSemaphore<WakePolicyTestKernelSemaphore, NoSpin, NoStats, NoAlignment, CascadingWake>> tester;
+    return tester.test(8, 8, 50000);
+}
@@ -0,0 +1,66 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#ifndef __CPP11OM_BENCHMARK_H__
+#define __CPP11OM_BENCHMARK_H__
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <cstdint>
+
+
+//---------------------------------------------------------
+// reportResult
+// Prints one measurement per line as tab-separated columns,
+// so the output is easy to paste into a spreadsheet.
+//---------------------------------------------------------
+inline void reportResult(const char* benchmark, const char* variant, int threadCount, const char* metric, double value)
+{
+    std::cout << benchmark << '\t' << variant << '\t' << threadCount << '\t' << metric << '\t' << value << '\n';
+}
+
+
+//---------------------------------------------------------
+// benchmarkThreadCounts
+// Powers of two up to the number of hardware threads, plus the number of hardware threads.
+//---------------------------------------------------------
+inline std::vector<int> benchmarkThreadCounts()
+{
+    int hwThreads = (int) std::thread::hardware_concurrency();
+    if (hwThreads < 1)
+        hwThreads = 1;
+    std::vector<int> counts;
+    for (int n = 1; n < hwThreads; n *= 2)
+        counts.push_back(n);
+    counts.push_back(hwThreads);
+    return counts;
+}
+
+
+//---------------------------------------------------------
+// FastRandom
+// xorshift32. The benchmarks need randomness that costs much less than the
+// operations being measured, which rules out std::mt19937.
+//---------------------------------------------------------
+class FastRandom
+{
+private:
+    uint32_t m_state;
+
+public:
+    FastRandom(uint32_t seed) : m_state(seed * 2654435761u + 1) {}
+
+    uint32_t next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+};
+
+
+#endif // __CPP11OM_BENCHMARK_H__
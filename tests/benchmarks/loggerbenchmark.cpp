@@ -0,0 +1,144 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include "inmemorylogger.h"
+#include "compactinmemorylogger.h"
+#include "shardedinmemorylogger.h"
+#include "benchmark.h"
+
+
+//---------------------------------------------------------
+// LoggerBenchmark
+// Measures the cost of log() in each of the in-memory loggers, and the cost of iterating
+// over the result. Every logger is created fresh for each run, so page allocation is
+// included in the cost of log(), just as it would be in a real program.
+//---------------------------------------------------------
+template <class LoggerType>
+class LoggerBenchmark
+{
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    std::unique_ptr<LoggerType> m_logger;   // Too big for the stack.
+    int m_eventsPerThread;
+    std::atomic<int> m_ready;
+    std::atomic<bool> m_go;
+
+    static double secondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start).count();
+    }
+
+    void threadFunc(int threadNum)
+    {
+        m_ready.fetch_add(1, std::memory_order_relaxed);
+        while (!m_go.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        for (int i = 0; i < m_eventsPerThread; i++)
+            m_logger->log("event", i);
+    }
+
+public:
+    LoggerBenchmark() : m_logger(new LoggerType), m_eventsPerThread(0), m_ready(0), m_go(false) {}
+
+    // Returns the total number of events logged per second by all threads together.
+    double runThroughput(int threadCount, int eventsPerThread)
+    {
+        m_eventsPerThread = eventsPerThread;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&LoggerBenchmark::threadFunc, this, i);
+        while (m_ready.load(std::memory_order_relaxed) < threadCount)
+            std::this_thread::yield();
+        Clock::time_point start = Clock::now();
+        m_go.store(true, std::memory_order_release);
+        for (std::thread& t : threads)
+            t.join();
+        return (double) threadCount * eventsPerThread / secondsSince(start);
+    }
+
+    // Times every call to log() on a single thread, to catch the calls that allocate a page.
+    // Returns sorted latencies in nanoseconds. Each one includes the overhead of reading the clock.
+    std::vector<uint64_t> runLatency(int eventCount)
+    {
+        std::vector<uint64_t> latencies(eventCount);     // Allocated up front so that it doesn't skew the results.
+        for (int i = 0; i < eventCount; i++)
+        {
+            Clock::time_point start = Clock::now();
+            m_logger->log("event", i);
+            latencies[i] = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        }
+        std::sort(latencies.begin(), latencies.end());
+        return latencies;
+    }
+
+    // Logs eventCount events, then returns the number of events iterated per second.
+    double runIteration(int eventCount)
+    {
+        for (int i = 0; i < eventCount; i++)
+            m_logger->log("event", i);
+        Clock::time_point start = Clock::now();
+        size_t sum = 0;
+        for (const auto& evt : *m_logger)
+            sum += evt.param;
+        double elapsed = secondsSince(start);
+        volatile size_t sink = sum;     // Prevent compiler from eliminating the loop
+        (void) sink;
+        return eventCount / elapsed;
+    }
+};
+
+template <class LoggerType>
+void benchmarkLoggerType(const char* variant)
+{
+    // Single-threaded cost per event.
+    {
+        static const int EVENT_COUNT = 4000000;
+        LoggerBenchmark<LoggerType> benchmark;
+        double eventsPerSec = benchmark.runThroughput(1, EVENT_COUNT);
+        reportResult("Logger", variant, 1, "ns per event", 1e9 / eventsPerSec);
+    }
+
+    // Scaling with the number of threads.
+    static const int EVENTS_PER_THREAD = 1000000;
+    for (int threadCount : benchmarkThreadCounts())
+    {
+        LoggerBenchmark<LoggerType> benchmark;
+        double eventsPerSec = benchmark.runThroughput(threadCount, EVENTS_PER_THREAD);
+        reportResult("Logger", variant, threadCount, "M events/sec", eventsPerSec / 1e6);
+    }
+
+    // Latency spikes. About 1 in 16384 calls to InMemoryLogger::log() allocates a page, so the
+    // 99.99th percentile and the maximum are where page rollover shows up.
+    {
+        static const int EVENT_COUNT = 2000000;
+        LoggerBenchmark<LoggerType> benchmark;
+        std::vector<uint64_t> latencies = benchmark.runLatency(EVENT_COUNT);
+        reportResult("LoggerLatency", variant, 1, "median ns", (double) latencies[EVENT_COUNT / 2]);
+        reportResult("LoggerLatency", variant, 1, "99.99th percentile ns", (double) latencies[EVENT_COUNT - EVENT_COUNT / 10000]);
+        reportResult("LoggerLatency", variant, 1, "max ns", (double) latencies[EVENT_COUNT - 1]);
+    }
+
+    // Iteration speed. Scaled down from 100M events so that InMemoryLogger fits in 1 GB.
+    {
+        static const int EVENT_COUNT = 20000000;
+        LoggerBenchmark<LoggerType> benchmark;
+        double eventsPerSec = benchmark.runIteration(EVENT_COUNT);
+        reportResult("LoggerIteration", variant, 1, "M events/sec", eventsPerSec / 1e6);
+    }
+}
+
+void benchmarkLogger()
+{
+    benchmarkLoggerType<InMemoryLogger>("InMemoryLogger");
+    benchmarkLoggerType<CompactInMemoryLogger>("CompactInMemoryLogger");
+    benchmarkLoggerType<ShardedInMemoryLogger>("ShardedInMemoryLogger");
+}
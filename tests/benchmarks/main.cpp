@@ -0,0 +1,52 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <iostream>
+#include <cstring>
+
+
+//---------------------------------------------------------
+// List of benchmarks
+//---------------------------------------------------------
+struct BenchmarkInfo
+{
+    const char* name;
+    void (*benchmarkFunc)();
+};
+
+void benchmarkLogger();
+void benchmarkRWLock();
+void benchmarkReaderRelease();
+void benchmarkSemaphore();
+
+#define ADD_BENCHMARK(name) { #name, name },
+BenchmarkInfo g_benchmarks[] =
+{
+    ADD_BENCHMARK(benchmarkLogger)
+    ADD_BENCHMARK(benchmarkRWLock)
+    ADD_BENCHMARK(benchmarkReaderRelease)
+    ADD_BENCHMARK(benchmarkSemaphore)
+};
+
+//---------------------------------------------------------
+// main
+// With no arguments, runs every benchmark. Otherwise, runs only the ones named.
+//---------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    std::cout << "benchmark\tvariant\tthreads\tmetric\tvalue\n";
+    for (const BenchmarkInfo& benchmark : g_benchmarks)
+    {
+        bool selected = (argc <= 1);
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], benchmark.name) == 0)
+                selected = true;
+        }
+        if (selected)
+            benchmark.benchmarkFunc();
+    }
+    return 0;
+}
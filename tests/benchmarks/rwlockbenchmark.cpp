@@ -0,0 +1,264 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "rwlock.h"
+#include "readmostlyrwlock.h"
+#include "benchmark.h"
+
+
+// Whether the calling thread's read locks take the lock's fast path. Only ReadMostlyRWLock
+// sends some threads down a slow path, once all its reader slots are taken.
+template <class LockType>
+bool hasFastReadPath(const LockType&)
+{
+    return true;
+}
+
+inline bool hasFastReadPath(const ReadMostlyRWLock&)
+{
+    return ReadMostlyRWLock::hasReaderSlot();
+}
+
+
+//---------------------------------------------------------
+// RWLockBenchmark
+// Measures total throughput of short read and write sections.
+//---------------------------------------------------------
+template <class LockType>
+class RWLockBenchmark
+{
+private:
+    LockType m_rwLock;
+    int m_sharedInt;
+    int m_writeOneIn;
+    std::atomic<bool> m_stop;
+    std::atomic<uint64_t> m_totalOps;
+    std::atomic<int> m_slowReaders;
+
+public:
+    RWLockBenchmark()
+    : m_sharedInt(0)
+    , m_writeOneIn(0)
+    , m_stop(false)
+    , m_totalOps(0)
+    , m_slowReaders(0)
+    {}
+
+    void threadFunc(int threadNum)
+    {
+        if (!hasFastReadPath(m_rwLock))
+            m_slowReaders.fetch_add(1, std::memory_order_relaxed);
+        FastRandom random(threadNum + 1);
+        uint64_t ops = 0;
+        volatile int accumulator = 0;   // Prevent compiler from eliminating this variable
+
+        while (!m_stop.load(std::memory_order_relaxed))
+        {
+            for (int i = 0; i < 100; i++)
+            {
+                if (random.next() % m_writeOneIn == 0)
+                {
+                    WriteLockGuard<LockType> guard(m_rwLock);
+                    m_sharedInt++;
+                }
+                else
+                {
+                    ReadLockGuard<LockType> guard(m_rwLock);
+                    accumulator += m_sharedInt;
+                }
+            }
+            ops += 100;
+        }
+
+        m_totalOps.fetch_add(ops, std::memory_order_relaxed);
+    }
+
+    double run(int threadCount, int writeOneIn, double seconds)
+    {
+        m_writeOneIn = writeOneIn;
+        m_stop.store(false, std::memory_order_relaxed);
+        m_totalOps.store(0, std::memory_order_relaxed);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&RWLockBenchmark::threadFunc, this, i);
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        m_stop.store(true, std::memory_order_relaxed);
+        for (std::thread& t : threads)
+            t.join();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+        return m_totalOps.load(std::memory_order_relaxed) / elapsed;
+    }
+
+    // Number of threads in the last run whose read locks took the slow path.
+    int slowReaders() const
+    {
+        return m_slowReaders.load(std::memory_order_relaxed);
+    }
+};
+
+// Set reportSlowReaders for locks with a slow read path, to show how many threads took it.
+template <class LockType>
+void benchmarkRWLockType(const char* variant, bool reportSlowReaders = false)
+{
+    static const int writeRatios[] = { 100, 10000 };
+    for (int writeOneIn : writeRatios)
+    {
+        std::string metric = "ops/sec, 1 write per " + std::to_string(writeOneIn);
+        for (int threadCount : benchmarkThreadCounts())
+        {
+            RWLockBenchmark<LockType> benchmark;
+            double opsPerSec = benchmark.run(threadCount, writeOneIn, 0.25);
+            reportResult("RWLock", variant, threadCount, metric.c_str(), opsPerSec);
+            if (reportSlowReaders)
+                reportResult("RWLock", variant, threadCount, "threads on slow read path", benchmark.slowReaders());
+        }
+    }
+}
+
+void benchmarkRWLock()
+{
+    benchmarkRWLockType<NonRecursiveRWLock>("NonRecursiveRWLock");
+    if (AsymmetricFence::isAsymmetric())
+    {
+        benchmarkRWLockType<ReadMostlyRWLock>("ReadMostlyRWLock (membarrier)", true);
+        // Same machine, same lock, without membarrier, for comparison.
+        AsymmetricFence::forceFallback(true);
+        benchmarkRWLockType<ReadMostlyRWLock>("ReadMostlyRWLock (fences)", true);
+        AsymmetricFence::forceFallback(false);
+    }
+    else
+    {
+        benchmarkRWLockType<ReadMostlyRWLock>("ReadMostlyRWLock (fences)", true);
+    }
+}
+
+
+//---------------------------------------------------------
+// ReaderReleaseBenchmark
+// A writer holds the lock while N readers queue up behind it, then releases them all at once
+// with unlockWriter(). Each reader measures how long it took to get in after the release.
+// Compares waking every reader in one broadcast against baton passing (CascadingWake).
+//---------------------------------------------------------
+template <class LockType>
+class ReaderReleaseBenchmark
+{
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    LockType m_rwLock;
+    LightweightSemaphore m_roundStart;
+    LightweightSemaphore m_roundDone;
+    std::atomic<int> m_arrived;
+    std::atomic<int> m_finished;
+    int m_readerCount;
+    bool m_stop;                            // Protected by m_rwLock
+    Clock::time_point m_releaseTime;        // Protected by m_rwLock
+    std::atomic<uint64_t> m_totalLatencyNs;
+    std::atomic<uint64_t> m_maxLatencyNs;
+
+    void readerFunc()
+    {
+        for (;;)
+        {
+            m_roundStart.wait();
+            m_arrived.fetch_add(1, std::memory_order_relaxed);
+            m_rwLock.lockReader();
+            Clock::time_point now = Clock::now();
+            bool stop = m_stop;
+            uint64_t latency = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_releaseTime).count();
+            m_rwLock.unlockReader();
+            if (stop)
+                break;
+            m_totalLatencyNs.fetch_add(latency, std::memory_order_relaxed);
+            uint64_t maxLatency = m_maxLatencyNs.load(std::memory_order_relaxed);
+            while (latency > maxLatency && !m_maxLatencyNs.compare_exchange_weak(maxLatency, latency, std::memory_order_relaxed))
+            {
+            }
+            if (m_finished.fetch_add(1, std::memory_order_relaxed) + 1 == m_readerCount)
+                m_roundDone.signal();
+        }
+    }
+
+    void runRound(bool stop)
+    {
+        m_arrived.store(0, std::memory_order_relaxed);
+        m_finished.store(0, std::memory_order_relaxed);
+        m_rwLock.lockWriter();
+        m_roundStart.signal(m_readerCount);
+        // Give every reader time to block in lockReader().
+        while (m_arrived.load(std::memory_order_relaxed) < m_readerCount)
+            std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        m_stop = stop;
+        m_releaseTime = Clock::now();
+        m_rwLock.unlockWriter();
+        if (!stop)
+            m_roundDone.wait();
+    }
+
+public:
+    ReaderReleaseBenchmark()
+    : m_arrived(0)
+    , m_finished(0)
+    , m_readerCount(0)
+    , m_stop(false)
+    , m_totalLatencyNs(0)
+    , m_maxLatencyNs(0)
+    {}
+
+    // Returns the mean and worst microseconds from release to a reader getting in.
+    void run(int readerCount, int rounds, double& meanUsecs, double& maxUsecs)
+    {
+        m_readerCount = readerCount;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < readerCount; i++)
+            threads.emplace_back(&ReaderReleaseBenchmark::readerFunc, this);
+        runRound(false);    // Warm-up
+        m_totalLatencyNs.store(0, std::memory_order_relaxed);
+        m_maxLatencyNs.store(0, std::memory_order_relaxed);
+        for (int r = 0; r < rounds; r++)
+            runRound(false);
+        runRound(true);
+        for (std::thread& t : threads)
+            t.join();
+        meanUsecs = m_totalLatencyNs.load(std::memory_order_relaxed) / 1000.0 / ((double) rounds * readerCount);
+        maxUsecs = m_maxLatencyNs.load(std::memory_order_relaxed) / 1000.0;
+    }
+};
+
+template <class LockType>
+void benchmarkReaderReleaseType(const char* variant)
+{
+    for (int readerCount = 8; readerCount <= 256; readerCount *= 2)
+    {
+        ReaderReleaseBenchmark<LockType> benchmark;
+        double meanUsecs, maxUsecs;
+        benchmark.run(readerCount, 20, meanUsecs, maxUsecs);
+        reportResult("ReaderRelease", variant, readerCount, "mean usecs to enter", meanUsecs);
+        reportResult("ReaderRelease", variant, readerCount, "max usecs to enter", maxUsecs);
+    }
+}
+
+void benchmarkReaderRelease()
+{
+    typedef BasicLightweightSemaphore<Semaphore, DefaultSpin, NoStats, NoAlignment, CascadingWake> CascadingSemaphore;
+    benchmarkReaderReleaseType<NonRecursiveRWLock>("NonRecursiveRWLock");
+    benchmarkReaderReleaseType<BasicNonRecursiveRWLock<CascadingSemaphore>>("NonRecursiveRWLock, cascading wakes");
+#if defined(__linux__)
+    typedef BasicLightweightSemaphore<FutexSemaphore> FutexBroadcastSemaphore;
+    typedef BasicLightweightSemaphore<FutexSemaphore, DefaultSpin, NoStats, NoAlignment, CascadingWake> FutexCascadingSemaphore;
+    benchmarkReaderReleaseType<BasicNonRecursiveRWLock<FutexBroadcastSemaphore>>("NonRecursiveRWLock + futex");
+    benchmarkReaderReleaseType<BasicNonRecursiveRWLock<FutexCascadingSemaphore>>("NonRecursiveRWLock + futex, cascading wakes");
+#endif
+}
@@ -0,0 +1,305 @@
+//---------------------------------------------------------
+// For conditions of distribution and use, see
+// https://github.com/preshing/cpp11-on-multicore/blob/master/LICENSE
+//---------------------------------------------------------
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "sema.h"
+#include "benchmark.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+
+#if defined(__linux__)
+//---------------------------------------------------------
+// Alternative kernel semaphores for Linux
+// Each one has the interface that BasicLightweightSemaphore expects of its SemaphoreType.
+// Semaphore, FutexSemaphore and EventfdSemaphore are in sema.h.
+//---------------------------------------------------------
+
+// The textbook semaphore: a count protected by a mutex, with a condition variable.
+class CondVarSemaphore
+{
+private:
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond;
+    int m_count;
+
+    CondVarSemaphore(const CondVarSemaphore& other) = delete;
+    CondVarSemaphore& operator=(const CondVarSemaphore& other) = delete;
+
+public:
+    CondVarSemaphore() : m_count(0)
+    {
+        pthread_mutex_init(&m_mutex, nullptr);
+        pthread_cond_init(&m_cond, nullptr);
+    }
+
+    ~CondVarSemaphore()
+    {
+        pthread_cond_destroy(&m_cond);
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    void wait()
+    {
+        pthread_mutex_lock(&m_mutex);
+        while (m_count == 0)
+            pthread_cond_wait(&m_cond, &m_mutex);
+        m_count--;
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    void signal(int count = 1)
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_count += count;
+        pthread_mutex_unlock(&m_mutex);
+        if (count == 1)
+            pthread_cond_signal(&m_cond);
+        else
+            pthread_cond_broadcast(&m_cond);
+    }
+};
+
+// One byte in a pipe per unit. Each wait() is a read() syscall that blocks until a byte arrives.
+class PipeSemaphore
+{
+private:
+    int m_fds[2];
+
+    PipeSemaphore(const PipeSemaphore& other) = delete;
+    PipeSemaphore& operator=(const PipeSemaphore& other) = delete;
+
+public:
+    PipeSemaphore()
+    {
+        int rc = pipe(m_fds);
+        assert(rc == 0);
+        (void) rc;
+    }
+
+    ~PipeSemaphore()
+    {
+        close(m_fds[0]);
+        close(m_fds[1]);
+    }
+
+    void wait()
+    {
+        char byte;
+        while (read(m_fds[0], &byte, 1) != 1)
+            assert(errno == EINTR);
+    }
+
+    void signal(int count = 1)
+    {
+        // The benchmarks never have anywhere near PIPE_BUF units outstanding, so this never blocks.
+        char bytes[64] = {};
+        while (count > 0)
+        {
+            int chunk = count < (int) sizeof(bytes) ? count : (int) sizeof(bytes);
+            ssize_t written = write(m_fds[1], bytes, chunk);
+            if (written > 0)
+                count -= (int) written;
+            else
+                assert(errno == EINTR);
+        }
+    }
+};
+#endif
+
+
+//---------------------------------------------------------
+// SemaphoreBenchmark
+// Runs three wake-up topologies on a given semaphore type:
+// - pingPong: Two threads take turns, waking each other. Measures round trip latency.
+// - fanOut: One thread wakes N waiters on a single semaphore with one signal(N) call,
+//   then waits for all of them to acknowledge. Measures broadcast rounds per second.
+// - fanIn: N threads compete to hand items to one consumer, one at a time, through a pair
+//   of semaphores. Measures items per second.
+// The thread that drives each topology checks the clock and wakes the others when time is up.
+//---------------------------------------------------------
+template <class SemaType>
+class SemaphoreBenchmark
+{
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    SemaType m_a;
+    SemaType m_b;
+    std::atomic<bool> m_stop;
+
+    static double elapsedSeconds(Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start).count();
+    }
+
+    void pingPongResponder()
+    {
+        for (;;)
+        {
+            m_b.wait();
+            if (m_stop.load(std::memory_order_relaxed))
+                break;
+            m_a.signal(1);
+        }
+    }
+
+    void fanOutWaiter()
+    {
+        for (;;)
+        {
+            m_a.wait();
+            if (m_stop.load(std::memory_order_relaxed))
+                break;
+            m_b.signal(1);
+        }
+    }
+
+    // m_a counts free slots, m_b counts items.
+    void fanInProducer()
+    {
+        for (;;)
+        {
+            m_a.wait();
+            if (m_stop.load(std::memory_order_relaxed))
+                break;
+            m_b.signal(1);
+        }
+    }
+
+public:
+    SemaphoreBenchmark() : m_stop(false) {}
+
+    // Returns nanoseconds per round trip.
+    double pingPong(double seconds)
+    {
+        std::thread responder(&SemaphoreBenchmark::pingPongResponder, this);
+        uint64_t roundTrips = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed;
+        for (;;)
+        {
+            for (int i = 0; i < 64; i++)
+            {
+                m_b.signal(1);
+                m_a.wait();
+            }
+            roundTrips += 64;
+            elapsed = elapsedSeconds(start);
+            if (elapsed >= seconds)
+                break;
+        }
+        m_stop.store(true, std::memory_order_relaxed);
+        m_b.signal(1);
+        responder.join();
+        return elapsed * 1e9 / roundTrips;
+    }
+
+    // Returns rounds per second.
+    double fanOut(int waiterCount, double seconds)
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < waiterCount; i++)
+            threads.emplace_back(&SemaphoreBenchmark::fanOutWaiter, this);
+        uint64_t rounds = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed;
+        for (;;)
+        {
+            m_a.signal(waiterCount);
+            for (int i = 0; i < waiterCount; i++)
+                m_b.wait();
+            rounds++;
+            elapsed = elapsedSeconds(start);
+            if (elapsed >= seconds)
+                break;
+        }
+        m_stop.store(true, std::memory_order_relaxed);
+        m_a.signal(waiterCount);
+        for (std::thread& t : threads)
+            t.join();
+        return rounds / elapsed;
+    }
+
+    // Returns items per second.
+    double fanIn(int producerCount, double seconds)
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < producerCount; i++)
+            threads.emplace_back(&SemaphoreBenchmark::fanInProducer, this);
+        uint64_t items = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed;
+        m_a.signal(1);      // One free slot
+        for (;;)
+        {
+            for (int i = 0; i < 64; i++)
+            {
+                m_b.wait();
+                m_a.signal(1);
+            }
+            items += 64;
+            elapsed = elapsedSeconds(start);
+            if (elapsed >= seconds)
+                break;
+        }
+        // Every producer is either waiting for a slot or about to be. Let them all through.
+        m_stop.store(true, std::memory_order_relaxed);
+        m_a.signal(producerCount);
+        for (std::thread& t : threads)
+            t.join();
+        return items / elapsed;
+    }
+};
+
+template <class SemaType>
+void benchmarkSemaphoreType(const char* variant)
+{
+    {
+        SemaphoreBenchmark<SemaType> benchmark;
+        reportResult("Semaphore", variant, 2, "ns per ping-pong round trip", benchmark.pingPong(0.25));
+    }
+    for (int threadCount : benchmarkThreadCounts())
+    {
+        SemaphoreBenchmark<SemaType> benchmark;
+        reportResult("Semaphore", variant, threadCount, "fan-out rounds/sec", benchmark.fanOut(threadCount, 0.25));
+    }
+    for (int threadCount : benchmarkThreadCounts())
+    {
+        SemaphoreBenchmark<SemaType> benchmark;
+        reportResult("Semaphore", variant, threadCount, "fan-in items/sec", benchmark.fanIn(threadCount, 0.25));
+    }
+}
+
+void benchmarkSemaphore()
+{
+    // Each kernel primitive behind the same LightweightSemaphore front end, as the other
+    // primitives would use it, then on its own, which is what the front end falls back to.
+#if defined(__linux__)
+    benchmarkSemaphoreType<LightweightSemaphore>("LightweightSemaphore + sem_t");
+    benchmarkSemaphoreType<BasicLightweightSemaphore<FutexSemaphore>>("LightweightSemaphore + futex");
+    benchmarkSemaphoreType<BasicLightweightSemaphore<FutexSemaphore, DefaultSpin, NoStats, NoAlignment, CoalescedWake>>(
+        "LightweightSemaphore + futex, coalesced wakes");
+    benchmarkSemaphoreType<BasicLightweightSemaphore<EventfdSemaphore>>("LightweightSemaphore + eventfd");
+    benchmarkSemaphoreType<BasicLightweightSemaphore<CondVarSemaphore>>("LightweightSemaphore + pthread_cond");
+    benchmarkSemaphoreType<BasicLightweightSemaphore<PipeSemaphore>>("LightweightSemaphore + pipe");
+    benchmarkSemaphoreType<Semaphore>("sem_t");
+    benchmarkSemaphoreType<FutexSemaphore>("futex");
+    benchmarkSemaphoreType<EventfdSemaphore>("eventfd");
+    benchmarkSemaphoreType<CondVarSemaphore>("pthread_cond");
+    benchmarkSemaphoreType<PipeSemaphore>("pipe");
+#else
+    benchmarkSemaphoreType<LightweightSemaphore>("LightweightSemaphore");
+    benchmarkSemaphoreType<Semaphore>("Semaphore");
+#endif
+}